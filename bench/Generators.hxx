@@ -0,0 +1,128 @@
+/**
+ * @file Generators.hxx
+ * @brief Synthetic data for the benchmarks, loosely modelled on HEP event records
+ */
+
+#ifndef H5COMPOSITES_BENCH_GENERATORS_HXX
+#define H5COMPOSITES_BENCH_GENERATORS_HXX
+
+#include "H5Composites/H5Struct.hxx"
+
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace H5Composites::bench {
+    /// A reconstructed particle
+    struct Particle {
+        float pt;
+        float eta;
+        float phi;
+        float m;
+        int pdgId;
+        short charge;
+        unsigned char quality;
+
+        H5COMPOSITES_INLINE_STRUCT_DTYPE(Particle, pt, eta, phi, m, pdgId, charge, quality)
+    };
+
+    /// A fixed size event summary with nested compounds and arrays
+    struct Event {
+        unsigned long long eventNumber;
+        unsigned int runNumber;
+        unsigned int lumiBlock;
+        double weight;
+        float met[2];
+        Particle leading;
+        Particle subleading;
+        unsigned short nJets;
+        unsigned short nTracks;
+
+        H5COMPOSITES_INLINE_STRUCT_DTYPE(
+                Event, eventNumber, runNumber, lumiBlock, weight, met, leading, subleading, nJets,
+                nTracks)
+    };
+
+    /// Reproducible source of synthetic rows
+    class Generator {
+    public:
+        explicit Generator(std::uint64_t seed = 12345) : m_engine(seed) {}
+
+        Particle particle() {
+            std::normal_distribution<float> eta(0.f, 1.5f);
+            std::uniform_real_distribution<float> phi(-3.14159f, 3.14159f);
+            std::uniform_int_distribution<int> type(0, 3);
+            static constexpr int pdgIds[]{11, 13, 22, 211};
+            int pdgId = pdgIds[type(m_engine)];
+            return Particle{
+                    m_pt(m_engine) + 20.f,
+                    eta(m_engine),
+                    phi(m_engine),
+                    pdgId == 22 ? 0.f : 0.105f,
+                    pdgId,
+                    static_cast<short>(pdgId == 22 ? 0 : (m_engine() % 2 ? 1 : -1)),
+                    static_cast<unsigned char>(m_engine() % 4)};
+        }
+
+        Event event() {
+            std::uniform_real_distribution<float> phi(-3.14159f, 3.14159f);
+            std::poisson_distribution<unsigned short> nJets(4);
+            std::poisson_distribution<unsigned short> nTracks(40);
+            float met = m_pt(m_engine);
+            float metPhi = phi(m_engine);
+            return Event{
+                    m_eventNumber++,
+                    356124,
+                    static_cast<unsigned int>(m_eventNumber / 1000),
+                    1.0 + 0.01 * std::normal_distribution<double>()(m_engine),
+                    {met * std::cos(metPhi), met * std::sin(metPhi)},
+                    particle(),
+                    particle(),
+                    nJets(m_engine),
+                    nTracks(m_engine)};
+        }
+
+        /// Per-event track measurements, a variable length vector
+        std::vector<float> hits() {
+            std::poisson_distribution<std::size_t> n(25);
+            std::vector<float> values(n(m_engine));
+            for (float &value : values)
+                value = m_pt(m_engine);
+            return values;
+        }
+
+        /// Per-event fired trigger name, a variable length string
+        std::string trigger() {
+            static const std::vector<std::string> names{
+                    "HLT_e26_lhtight_ivarloose", "HLT_mu26_ivarmedium", "HLT_2mu14",
+                    "HLT_j420_a10t_lcw_jes_35smcINF", "HLT_xe110_pufit_xe65_L1XE50",
+                    "HLT_g140_loose"};
+            return names[m_engine() % names.size()];
+        }
+
+        std::vector<Event> events(std::size_t n) { return fill(n, &Generator::event); }
+
+        std::vector<std::vector<float>> hitsVectors(std::size_t n) {
+            return fill(n, &Generator::hits);
+        }
+
+        std::vector<std::string> triggers(std::size_t n) { return fill(n, &Generator::trigger); }
+
+    private:
+        template <typename T> std::vector<T> fill(std::size_t n, T (Generator::*f)()) {
+            std::vector<T> values;
+            values.reserve(n);
+            for (std::size_t idx = 0; idx < n; ++idx)
+                values.push_back((this->*f)());
+            return values;
+        }
+
+        std::mt19937_64 m_engine;
+        std::exponential_distribution<float> m_pt{1.f / 30.f};
+        unsigned long long m_eventNumber{0};
+    };
+} // namespace H5Composites::bench
+
+#endif //> !H5COMPOSITES_BENCH_GENERATORS_HXX
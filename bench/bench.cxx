@@ -0,0 +1,569 @@
+/**
+ * @file bench.cxx
+ * @brief End-to-end I/O benchmarks, written out as JSON
+ *
+ * Usage: h5composites_bench [--rows N] [--repeats N] [--filter SUBSTRING] [--dir DIRECTORY]
+ *                           [--output FILE]
+ *
+ * Each benchmark is run over a grid of cache sizes, chunk sizes and thread counts. Every
+ * configuration is repeated and the fastest and median times are reported. The raw_* benchmarks
+ * perform the same operations directly through the H5 C API as a baseline. Files are opened and
+ * closed outside of the timed region in both.
+ */
+
+#include "Generators.hxx"
+
+#include "H5Composites/ConcurrentWriter.hxx"
+#include "H5Composites/DataSetUtils.hxx"
+#include "H5Composites/ParallelScan.hxx"
+#include "H5Composites/GroupWrapper.hxx"
+#include "H5Composites/Reader.hxx"
+#include "H5Composites/TypeRegister.hxx"
+#include "H5Composites/TypedReader.hxx"
+#include "H5Composites/TypedWriter.hxx"
+#include "H5Composites/traits/String.hxx"
+#include "H5Composites/traits/Vector.hxx"
+
+#include "H5Cpp.h"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace H5Composites;
+using namespace H5Composites::bench;
+
+namespace {
+    using Params = std::vector<std::pair<std::string, std::size_t>>;
+
+    struct Result {
+        std::string name;
+        Params params;
+        std::size_t rows;
+        std::size_t bytes;
+        std::vector<double> seconds;
+    };
+
+    class Timer {
+    public:
+        Timer() : m_start(std::chrono::steady_clock::now()) {}
+
+        double seconds() const {
+            return std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start)
+                    .count();
+        }
+
+    private:
+        std::chrono::steady_clock::time_point m_start;
+    };
+
+    struct Config {
+        std::size_t rows = 100000;
+        std::size_t repeats = 3;
+        std::string filter;
+        std::filesystem::path dir = ".";
+        std::string output;
+    };
+
+    /// Runs the benchmarks and collects their results
+    class Harness {
+    public:
+        explicit Harness(const Config &config) : m_config(config) {}
+
+        const Config &config() const { return m_config; }
+
+        /// The path of a scratch file, removed before being handed out
+        std::string scratch(const std::string &name) const {
+            std::filesystem::path path = m_config.dir / ("h5composites_bench_" + name + ".h5");
+            std::filesystem::remove(path);
+            return path.string();
+        }
+
+        /**
+         * @brief Run a single configuration
+         * @param name The benchmark name
+         * @param params The configuration
+         * @param rows The number of rows processed in each run
+         * @param bytes The number of payload bytes processed in each run
+         * @param run Does the setup, then runs the timed section and returns its duration
+         */
+        void run(
+                const std::string &name, const Params &params, std::size_t rows,
+                std::size_t bytes, const std::function<double()> &run) {
+            if (!m_config.filter.empty() && name.find(m_config.filter) == std::string::npos)
+                return;
+            Result result{name, params, rows, bytes, {}};
+            for (std::size_t idx = 0; idx < m_config.repeats; ++idx)
+                result.seconds.push_back(run());
+            std::sort(result.seconds.begin(), result.seconds.end());
+            std::cerr << name;
+            for (const auto &[key, value] : params)
+                std::cerr << " " << key << "=" << value;
+            std::cerr << ": " << result.seconds.front() << "s" << std::endl;
+            m_results.push_back(std::move(result));
+        }
+
+        void writeJSON(std::ostream &os) const {
+            os << "{\n  \"rows\": " << m_config.rows << ",\n  \"repeats\": " << m_config.repeats
+               << ",\n  \"results\": [";
+            for (std::size_t idx = 0; idx < m_results.size(); ++idx) {
+                const Result &result = m_results[idx];
+                double best = result.seconds.front();
+                double median = result.seconds[result.seconds.size() / 2];
+                os << (idx ? "," : "") << "\n    {\"name\": \"" << result.name
+                   << "\", \"params\": {";
+                for (std::size_t iParam = 0; iParam < result.params.size(); ++iParam)
+                    os << (iParam ? ", " : "") << "\"" << result.params[iParam].first
+                       << "\": " << result.params[iParam].second;
+                os << "}, \"rows\": " << result.rows << ", \"bytes\": " << result.bytes
+                   << ", \"seconds_min\": " << best << ", \"seconds_median\": " << median
+                   << ", \"rows_per_second\": " << result.rows / best
+                   << ", \"mb_per_second\": " << result.bytes / best / 1e6 << "}";
+            }
+            os << "\n  ]\n}\n";
+        }
+
+    private:
+        Config m_config;
+        std::vector<Result> m_results;
+    };
+
+    const std::vector<std::size_t> cacheSizes{256, 4096, 65536};
+    const std::vector<std::size_t> chunkSizes{1024, 16384};
+    const std::vector<std::size_t> threadCounts{1, 2, 4, 8};
+
+    std::size_t payloadBytes(const std::vector<std::vector<float>> &vectors) {
+        std::size_t bytes = 0;
+        for (const std::vector<float> &v : vectors)
+            bytes += v.size() * sizeof(float);
+        return bytes;
+    }
+
+    std::size_t payloadBytes(const std::vector<std::string> &strings) {
+        std::size_t bytes = 0;
+        for (const std::string &s : strings)
+            bytes += s.size();
+        return bytes;
+    }
+
+    /// Create a chunked, extendable 1D dataset with the C API
+    hid_t rawCreate(hid_t file, const char *name, hid_t dtype, hsize_t chunkSize) {
+        hsize_t dims[1]{0};
+        hsize_t maxDims[1]{H5S_UNLIMITED};
+        hid_t space = H5Screate_simple(1, dims, maxDims);
+        hid_t propList = H5Pcreate(H5P_DATASET_CREATE);
+        H5Pset_chunk(propList, 1, &chunkSize);
+        hid_t dataset = H5Dcreate2(file, name, dtype, space, H5P_DEFAULT, propList, H5P_DEFAULT);
+        H5Pclose(propList);
+        H5Sclose(space);
+        return dataset;
+    }
+
+    /// Append n rows to a dataset with the C API
+    void rawAppend(hid_t dataset, hid_t dtype, hsize_t offset, hsize_t n, const void *buffer) {
+        hsize_t size[1]{offset + n};
+        H5Dset_extent(dataset, size);
+        hid_t fileSpace = H5Dget_space(dataset);
+        H5Sselect_hyperslab(fileSpace, H5S_SELECT_SET, &offset, nullptr, &n, nullptr);
+        hid_t memSpace = H5Screate_simple(1, &n, nullptr);
+        H5Dwrite(dataset, dtype, memSpace, fileSpace, H5P_DEFAULT, buffer);
+        H5Sclose(memSpace);
+        H5Sclose(fileSpace);
+    }
+
+    /// Read n rows from a dataset with the C API
+    void rawRead(hid_t dataset, hid_t dtype, hsize_t offset, hsize_t n, void *buffer) {
+        hid_t fileSpace = H5Dget_space(dataset);
+        H5Sselect_hyperslab(fileSpace, H5S_SELECT_SET, &offset, nullptr, &n, nullptr);
+        hid_t memSpace = H5Screate_simple(1, &n, nullptr);
+        H5Dread(dataset, dtype, memSpace, fileSpace, H5P_DEFAULT, buffer);
+        H5Sclose(memSpace);
+        H5Sclose(fileSpace);
+    }
+
+    /// Write events to a new file, to be read back by the read benchmarks
+    template <typename T>
+    std::string prepare(
+            Harness &harness, const std::string &name, const std::vector<T> &values,
+            std::size_t chunkSize) {
+        std::string path = harness.scratch(name);
+        H5::H5File file(path, H5F_ACC_TRUNC);
+        TypedWriter<T> writer(file, "data", chunkSize, chunkSize);
+        writer.write(values.begin(), values.end());
+        return path;
+    }
+
+    void writeBenchmarks(Harness &harness, Generator &generator) {
+        std::size_t nRows = harness.config().rows;
+        std::vector<Event> events = generator.events(nRows);
+        std::size_t eventBytes = nRows * sizeof(Event);
+        for (std::size_t cacheSize : cacheSizes)
+            for (std::size_t chunkSize : chunkSizes) {
+                for (std::size_t async : {0, 1})
+                    harness.run(
+                            "write_compound",
+                            {{"cache_size", cacheSize},
+                             {"chunk_size", chunkSize},
+                             {"async", async}},
+                            nRows, eventBytes, [&] {
+                                H5::H5File file(harness.scratch("write"), H5F_ACC_TRUNC);
+                                Timer timer;
+                                {
+                                    TypedWriter<Event> writer(file, "data", cacheSize, chunkSize);
+                                    if (async)
+                                        writer.startAsyncFlushing();
+                                    for (const Event &event : events)
+                                        writer.write(event);
+                                }
+                                return timer.seconds();
+                            });
+                harness.run(
+                        "write_compound_span",
+                        {{"cache_size", cacheSize}, {"chunk_size", chunkSize}}, nRows, eventBytes,
+                        [&] {
+                            H5::H5File file(harness.scratch("write"), H5F_ACC_TRUNC);
+                            Timer timer;
+                            {
+                                TypedWriter<Event> writer(file, "data", cacheSize, chunkSize);
+                                writer.write(std::span<const Event>(events));
+                            }
+                            return timer.seconds();
+                        });
+                harness.run(
+                        "raw_write_compound",
+                        {{"cache_size", cacheSize}, {"chunk_size", chunkSize}}, nRows, eventBytes,
+                        [&] {
+                            H5::H5File file(harness.scratch("write"), H5F_ACC_TRUNC);
+                            hid_t dtype = getH5DType<Event>().getId();
+                            Timer timer;
+                            hid_t dataset = rawCreate(file.getId(), "data", dtype, chunkSize);
+                            for (hsize_t offset = 0; offset < nRows; offset += cacheSize)
+                                rawAppend(
+                                        dataset, dtype, offset,
+                                        std::min<hsize_t>(cacheSize, nRows - offset),
+                                        events.data() + offset);
+                            H5Dclose(dataset);
+                            return timer.seconds();
+                        });
+            }
+
+        std::vector<std::vector<float>> hits = generator.hitsVectors(nRows);
+        std::vector<std::string> triggers = generator.triggers(nRows);
+        for (std::size_t cacheSize : cacheSizes)
+            for (std::size_t arena : {0, 1}) {
+                harness.run(
+                        "write_vlen_vector", {{"cache_size", cacheSize}, {"arena", arena}}, nRows,
+                        payloadBytes(hits), [&] {
+                            H5::H5File file(harness.scratch("write"), H5F_ACC_TRUNC);
+                            Timer timer;
+                            {
+                                TypedWriter<std::vector<float>> writer(file, "data", cacheSize);
+                                if (arena)
+                                    writer.useVLenArena();
+                                for (const std::vector<float> &value : hits)
+                                    writer.write(value);
+                            }
+                            return timer.seconds();
+                        });
+                harness.run(
+                        "write_string", {{"cache_size", cacheSize}, {"arena", arena}}, nRows,
+                        payloadBytes(triggers), [&] {
+                            H5::H5File file(harness.scratch("write"), H5F_ACC_TRUNC);
+                            Timer timer;
+                            {
+                                TypedWriter<std::string> writer(file, "data", cacheSize);
+                                if (arena)
+                                    writer.useVLenArena();
+                                for (const std::string &value : triggers)
+                                    writer.write(value);
+                            }
+                            return timer.seconds();
+                        });
+            }
+
+        for (std::size_t nThreads : threadCounts)
+            harness.run(
+                    "write_concurrent", {{"threads", nThreads}, {"block_size", 4096}}, nRows,
+                    eventBytes, [&] {
+                        H5::H5File file(harness.scratch("write"), H5F_ACC_TRUNC);
+                        Timer timer;
+                        {
+                            ConcurrentWriter writer(file, "data", getH5DType<Event>(), 4096);
+                            std::vector<std::thread> threads;
+                            for (std::size_t thread = 0; thread < nThreads; ++thread)
+                                threads.emplace_back([&, thread] {
+                                    ConcurrentWriter::Producer producer = writer.makeProducer();
+                                    for (std::size_t idx = thread; idx < nRows; idx += nThreads)
+                                        producer.write(events[idx]);
+                                });
+                            for (std::thread &thread : threads)
+                                thread.join();
+                        }
+                        return timer.seconds();
+                    });
+    }
+
+    void readBenchmarks(Harness &harness, Generator &generator) {
+        std::size_t nRows = harness.config().rows;
+        std::vector<Event> events = generator.events(nRows);
+        std::size_t eventBytes = nRows * sizeof(Event);
+        for (std::size_t chunkSize : chunkSizes) {
+            std::string path = prepare(harness, "read", events, chunkSize);
+            H5::H5File file(path, H5F_ACC_RDONLY);
+            for (std::size_t cacheSize : cacheSizes) {
+                Params params{{"cache_size", cacheSize}, {"chunk_size", chunkSize}};
+                harness.run("read_compound", params, nRows, eventBytes, [&] {
+                    Timer timer;
+                    TypedReader<Event> reader(file.openDataSet("data"), cacheSize);
+                    while (reader.next())
+                        ;
+                    return timer.seconds();
+                });
+                harness.run(
+                        "read_compound_prefetch", params, nRows, eventBytes, [&] {
+                            Timer timer;
+                            Reader reader(file.openDataSet("data"), cacheSize);
+                            reader.startPrefetching();
+                            while (reader.next<Event>())
+                                ;
+                            return timer.seconds();
+                        });
+                harness.run("read_compound_into", params, nRows, eventBytes, [&] {
+                    std::vector<Event> target(cacheSize);
+                    Timer timer;
+                    TypedReader<Event> reader(file.openDataSet("data"), cacheSize);
+                    while (reader.readInto(std::span(target)) == cacheSize)
+                        ;
+                    return timer.seconds();
+                });
+                harness.run("raw_read_compound", params, nRows, eventBytes, [&] {
+                    std::vector<Event> target(cacheSize);
+                    hid_t dtype = getH5DType<Event>().getId();
+                    Timer timer;
+                    hid_t dataset = H5Dopen2(file.getId(), "data", H5P_DEFAULT);
+                    for (hsize_t offset = 0; offset < nRows; offset += cacheSize)
+                        rawRead(dataset, dtype, offset,
+                                std::min<hsize_t>(cacheSize, nRows - offset), target.data());
+                    H5Dclose(dataset);
+                    return timer.seconds();
+                });
+            }
+            for (std::size_t nThreads : {0, 1, 2, 4, 8})
+                harness.run(
+                        "scan_parallel", {{"threads", nThreads}, {"chunk_size", chunkSize}},
+                        nRows, eventBytes, [&] {
+                            Timer timer;
+                            ParallelScan scan(getH5DType<Event>(), file.openDataSet("data"),
+                                              nThreads);
+                            // Touch every row so the callback is not optimised away
+                            std::size_t nSeen = scan.reduce(
+                                    std::size_t{0},
+                                    [](std::size_t &state, std::size_t,
+                                       const H5BufferConstView &rows, std::size_t n) {
+                                        const Event *event =
+                                                static_cast<const Event *>(rows.get());
+                                        for (std::size_t idx = 0; idx < n; ++idx)
+                                            state += event[idx].eventNumber != 0;
+                                    },
+                                    [](std::size_t lhs, std::size_t rhs) { return lhs + rhs; });
+                            if (nSeen > nRows)
+                                throw std::logic_error("Scan saw too many rows");
+                            return timer.seconds();
+                        });
+        }
+
+        std::vector<std::vector<float>> hits = generator.hitsVectors(nRows);
+        std::vector<std::string> triggers = generator.triggers(nRows);
+        std::string hitsPath = prepare(harness, "read_vlen", hits, 4096);
+        std::string triggersPath = prepare(harness, "read_string", triggers, 4096);
+        H5::H5File hitsFile(hitsPath, H5F_ACC_RDONLY);
+        H5::H5File triggersFile(triggersPath, H5F_ACC_RDONLY);
+        for (std::size_t cacheSize : cacheSizes)
+            for (std::size_t arena : {0, 1}) {
+                Params params{{"cache_size", cacheSize}, {"arena", arena}};
+                harness.run("read_vlen_vector", params, nRows, payloadBytes(hits), [&] {
+                    Timer timer;
+                    TypedReader<std::vector<float>> reader(hitsFile.openDataSet("data"), cacheSize);
+                    if (arena)
+                        reader.useVLenArena();
+                    while (reader.next())
+                        ;
+                    return timer.seconds();
+                });
+                harness.run("read_string", params, nRows, payloadBytes(triggers), [&] {
+                    Timer timer;
+                    TypedReader<std::string> reader(triggersFile.openDataSet("data"), cacheSize);
+                    if (arena)
+                        reader.useVLenArena();
+                    while (reader.next())
+                        ;
+                    return timer.seconds();
+                });
+            }
+    }
+
+    void mergeBenchmarks(Harness &harness, Generator &generator) {
+        constexpr std::size_t nInputs = 4;
+        std::size_t nRows = harness.config().rows;
+        std::size_t nPerInput = nRows / nInputs;
+        std::string inputPath = harness.scratch("merge_inputs");
+        {
+            H5::H5File file(inputPath, H5F_ACC_TRUNC);
+            for (std::size_t idx = 0; idx < nInputs; ++idx) {
+                std::vector<Event> events = generator.events(nPerInput);
+                TypedWriter<Event> writer(file, "input" + std::to_string(idx), 4096, 4096);
+                writer.write(std::span<const Event>(events));
+            }
+        }
+        H5::H5File inputFile(inputPath, H5F_ACC_RDONLY);
+        std::vector<H5::DataSet> inputs;
+        for (std::size_t idx = 0; idx < nInputs; ++idx)
+            inputs.push_back(inputFile.openDataSet("input" + std::to_string(idx)));
+        std::size_t nMerged = nPerInput * nInputs;
+        std::size_t bytes = nMerged * sizeof(Event);
+        for (std::size_t bufferSize : {64 * 1024, 1024 * 1024})
+            for (std::size_t nThreads : {0, 1, 2, 4})
+                harness.run(
+                        "merge", {{"buffer_bytes", bufferSize}, {"threads", nThreads}}, nMerged,
+                        bytes, [&] {
+                            H5::H5File file(harness.scratch("merge"), H5F_ACC_TRUNC);
+                            H5::Group group = file.openGroup("/");
+                            Timer timer;
+                            mergeDataSets(group, "data", inputs, bufferSize, 0, {}, nThreads);
+                            return timer.seconds();
+                        });
+        harness.run("raw_merge", {{"buffer_rows", 4096}}, nMerged, bytes, [&] {
+            H5::H5File file(harness.scratch("merge"), H5F_ACC_TRUNC);
+            hid_t dtype = getH5DType<Event>().getId();
+            std::vector<Event> buffer(4096);
+            Timer timer;
+            hid_t target = rawCreate(file.getId(), "data", dtype, 4096);
+            hsize_t position = 0;
+            for (const H5::DataSet &input : inputs)
+                for (hsize_t offset = 0; offset < nPerInput; offset += buffer.size()) {
+                    hsize_t n = std::min<hsize_t>(buffer.size(), nPerInput - offset);
+                    rawRead(input.getId(), dtype, offset, n, buffer.data());
+                    rawAppend(target, dtype, position, n, buffer.data());
+                    position += n;
+                }
+            H5Dclose(target);
+            return timer.seconds();
+        });
+    }
+
+    void scalarBenchmarks(Harness &harness) {
+        std::size_t nScalars = std::min<std::size_t>(harness.config().rows, 2000);
+        std::string path = harness.scratch("scalars");
+        H5::H5File file(path, H5F_ACC_TRUNC);
+        H5::Group root = file.openGroup("/");
+        std::size_t iRun = 0;
+        harness.run("scalar_write", {{"scalars", nScalars}}, nScalars, nScalars * 8, [&] {
+            GroupWrapper group(
+                    root.createGroup("write" + std::to_string(iRun++)),
+                    TypeRegister::instance().enumType());
+            Timer timer;
+            for (std::size_t idx = 0; idx < nScalars; ++idx)
+                group.writeScalar<double>("s" + std::to_string(idx), 0.5 * idx);
+            return timer.seconds();
+        });
+        harness.run("scalar_read", {{"scalars", nScalars}}, nScalars, nScalars * 8, [&] {
+            GroupWrapper group(root.openGroup("write0"), TypeRegister::instance().enumType());
+            Timer timer;
+            double total = 0;
+            for (std::size_t idx = 0; idx < nScalars; ++idx)
+                total += group.readScalar<double>("s" + std::to_string(idx));
+            return timer.seconds() + 0 * total;
+        });
+        harness.run("raw_scalar_write", {{"scalars", nScalars}}, nScalars, nScalars * 8, [&] {
+            hid_t group = H5Gcreate2(
+                    file.getId(), ("raw" + std::to_string(iRun++)).c_str(), H5P_DEFAULT,
+                    H5P_DEFAULT, H5P_DEFAULT);
+            Timer timer;
+            hid_t space = H5Screate(H5S_SCALAR);
+            for (std::size_t idx = 0; idx < nScalars; ++idx) {
+                double value = 0.5 * idx;
+                hid_t dataset = H5Dcreate2(
+                        group, ("s" + std::to_string(idx)).c_str(), H5T_NATIVE_DOUBLE, space,
+                        H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+                H5Dwrite(dataset, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT, &value);
+                H5Dclose(dataset);
+            }
+            H5Sclose(space);
+            double seconds = timer.seconds();
+            H5Gclose(group);
+            return seconds;
+        });
+        harness.run("raw_scalar_read", {{"scalars", nScalars}}, nScalars, nScalars * 8, [&] {
+            hid_t group = H5Gopen2(file.getId(), "write0", H5P_DEFAULT);
+            Timer timer;
+            double total = 0;
+            for (std::size_t idx = 0; idx < nScalars; ++idx) {
+                double value;
+                hid_t dataset = H5Dopen2(group, ("s" + std::to_string(idx)).c_str(), H5P_DEFAULT);
+                H5Dread(dataset, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT, &value);
+                H5Dclose(dataset);
+                total += value;
+            }
+            double seconds = timer.seconds();
+            H5Gclose(group);
+            return seconds + 0 * total;
+        });
+    }
+
+    Config parse(int argc, char **argv) {
+        Config config;
+        for (int idx = 1; idx < argc; ++idx) {
+            std::string arg = argv[idx];
+            if (idx + 1 == argc)
+                throw std::invalid_argument("Missing value for " + arg);
+            std::string value = argv[++idx];
+            if (arg == "--rows")
+                config.rows = std::stoul(value);
+            else if (arg == "--repeats")
+                config.repeats = std::max<std::size_t>(std::stoul(value), 1);
+            else if (arg == "--filter")
+                config.filter = value;
+            else if (arg == "--dir")
+                config.dir = value;
+            else if (arg == "--output")
+                config.output = value;
+            else
+                throw std::invalid_argument("Unknown argument " + arg);
+        }
+        return config;
+    }
+} // namespace
+
+int main(int argc, char **argv) {
+    Config config;
+    try {
+        config = parse(argc, argv);
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    Harness harness(config);
+    Generator generator;
+    writeBenchmarks(harness, generator);
+    readBenchmarks(harness, generator);
+    mergeBenchmarks(harness, generator);
+    scalarBenchmarks(harness);
+    if (config.output.empty())
+        harness.writeJSON(std::cout);
+    else {
+        std::ofstream os(config.output);
+        harness.writeJSON(os);
+    }
+    for (const auto &entry : std::filesystem::directory_iterator(config.dir))
+        if (entry.path().filename().string().starts_with("h5composites_bench_"))
+            std::filesystem::remove(entry.path());
+    return 0;
+}
@@ -0,0 +1,63 @@
+/**
+ * @file BufferAllocator.hxx
+ * @brief Strategies for allocating the memory held by SmartBuffers
+ */
+
+#ifndef H5COMPOSITES_BUFFERALLOCATOR_HXX
+#define H5COMPOSITES_BUFFERALLOCATOR_HXX
+
+#include <cstddef>
+
+namespace H5Composites {
+    /**
+     * @brief Source of the memory held by a SmartBuffer
+     *
+     * Every allocator hands out memory that can be freed with std::free. This means that a
+     * pointer released from a SmartBuffer can always be given to code that expects malloc'd
+     * memory, e.g. the H5 vlen reclaim functions.
+     */
+    class BufferAllocator {
+    public:
+        /// The alignment used by the aligned allocators, enough for a cache line or SIMD load
+        static constexpr std::size_t alignment = 64;
+        /// The size of a transparent huge page
+        static constexpr std::size_t hugePageSize = 2 * 1024 * 1024;
+
+        virtual ~BufferAllocator() = default;
+
+        /// @brief Allocate memory, returning nullptr on failure
+        virtual void *allocate(std::size_t size) const = 0;
+
+        /// @brief Return memory allocated by this allocator
+        /// @param ptr The memory
+        /// @param size The size originally requested
+        virtual void deallocate(void *ptr, std::size_t size) const;
+
+        /// @brief Plain std::malloc
+        static const BufferAllocator &standard();
+
+        /// @brief Memory aligned to a 64 byte boundary
+        static const BufferAllocator &aligned();
+
+        /// @brief Aligned memory which uses transparent huge pages for large buffers
+        ///
+        /// Buffers of at least hugePageSize are aligned to a huge page boundary and marked for
+        /// the kernel to back with huge pages, reducing the number of page faults and TLB misses
+        /// for very large caches. Smaller buffers behave as for aligned().
+        static const BufferAllocator &hugePage();
+
+        /// @brief Reuses small allocations through per-thread free lists
+        ///
+        /// Allocations up to 4kB are rounded up to a power of two and returned to a free list for
+        /// that size on the deallocating thread. Larger allocations use std::malloc directly.
+        static const BufferAllocator &pooled();
+
+        /// @brief The allocator used for the Reader and Writer caches, aligned() by default
+        static const BufferAllocator &cache();
+
+        /// @brief Change the allocator used for the caches of Readers and Writers created later
+        static void setCache(const BufferAllocator &allocator);
+    };
+} // namespace H5Composites
+
+#endif //> !H5COMPOSITES_BUFFERALLOCATOR_HXX
@@ -0,0 +1,114 @@
+/**
+ * @file ColumnarReader.hxx
+ * @brief Class for reading compound data written by a ColumnarWriter
+ */
+
+#ifndef H5COMPOSITES_COLUMNARREADER_HXX
+#define H5COMPOSITES_COLUMNARREADER_HXX
+
+#include "H5Composites/BufferConstructTraits.hxx"
+#include "H5Composites/H5BufferConstView.hxx"
+#include "H5Composites/Reader.hxx"
+#include "H5Composites/SmartBuffer.hxx"
+#include "H5Composites/UnderlyingType.hxx"
+
+#include "H5Cpp.h"
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace H5Composites {
+    /**
+     * @brief Reassembles rows from a group written by a ColumnarWriter
+     *
+     * Blocks of each column are read and scattered into a cache of whole rows. Only the columns
+     * needed for the selected members are read. Single columns can also be read on their own with
+     * @ref columnReader.
+     */
+    class ColumnarReader {
+    public:
+        /// @brief Create a reader for all members
+        /// @param group The group written by the ColumnarWriter
+        /// @param cacheSize The number of rows to read into the cache at once. If not set will use
+        ///        the chunk size of the first column.
+        ColumnarReader(const H5::Group &group, std::size_t cacheSize = -1);
+
+        /// @brief Create a reader that only reads some members
+        /// @param group The group written by the ColumnarWriter
+        /// @param members The paths of the members to read, see projectCompoundDType
+        /// @param cacheSize The number of rows to read into the cache at once. If not set will use
+        ///        the chunk size of the first column.
+        ColumnarReader(
+                const H5::Group &group, const std::vector<std::string> &members,
+                std::size_t cacheSize = -1);
+
+        /// @brief The type of the reassembled rows
+        const H5::DataType &dtype() const { return m_dtype; }
+
+        /// @brief The names of the columns being read
+        const std::vector<std::string> &columnNames() const { return m_names; }
+
+        /// @brief Create a reader for a single column
+        /// @param name The full path of the member
+        /// @param cacheSize The cache size of the reader, see Reader
+        Reader columnReader(const std::string &name, std::size_t cacheSize = -1) const;
+
+        /// @brief Read the next row
+        /// @return A view of the next row, empty when all rows have been read
+        ///
+        /// Note that subsequent calls to next are allowed to modify this memory
+        H5BufferConstView next();
+
+        /// @brief Read the next row as the specified type
+        ///
+        /// Returns std::nullopt when all rows have been read
+        template <BufferConstructible T> std::optional<UnderlyingType_t<T>> next() {
+            if (H5BufferConstView view = next())
+                return fromBuffer<T>(view);
+            else
+                return std::nullopt;
+        }
+
+        /// @brief Read up to n contiguous rows
+        /// @param n The maximum number of rows to read
+        /// @return A view of an array holding the rows
+        ///
+        /// See Reader::nextBlock
+        H5BufferConstView nextBlock(std::size_t n);
+
+        /// @brief The number of rows remaining to be read
+        std::size_t nRemaining() const { return m_nRemaining + m_nInCache - m_cachePosition; }
+
+    private:
+        ColumnarReader(const H5::Group &group, const H5::DataType &dtype, std::size_t cacheSize);
+
+        struct Column {
+            /// The offset of the member in the reassembled row
+            std::size_t offset;
+            /// The reader, which only ever reads straight into the gather buffer
+            std::unique_ptr<Reader> reader;
+        };
+
+        /// @brief Read the next block of every column into the cache
+        /// @return False if there was nothing left to read
+        bool fillCache();
+
+        H5::Group m_group;
+        H5::DataType m_dtype;
+        std::size_t m_objectSize;
+        std::vector<std::string> m_names;
+        std::vector<Column> m_columns;
+        std::size_t m_cacheSize;
+        /// The reassembled rows
+        SmartBuffer m_buffer;
+        /// The values read from a single column
+        SmartBuffer m_values;
+        std::size_t m_cachePosition{0};
+        std::size_t m_nInCache{0};
+        std::size_t m_nRemaining{0};
+    };
+} // namespace H5Composites
+
+#endif //> !H5COMPOSITES_COLUMNARREADER_HXX
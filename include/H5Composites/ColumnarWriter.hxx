@@ -0,0 +1,142 @@
+/**
+ * @file ColumnarWriter.hxx
+ * @brief Class for writing compound data with one dataset per member
+ */
+
+#ifndef H5COMPOSITES_COLUMNARWRITER_HXX
+#define H5COMPOSITES_COLUMNARWRITER_HXX
+
+#include "H5Composites/BufferWriteTraits.hxx"
+#include "H5Composites/DataSetCreationOptions.hxx"
+#include "H5Composites/H5BufferConstView.hxx"
+#include "H5Composites/SmartBuffer.hxx"
+#include "H5Composites/UnderlyingType.hxx"
+#include "H5Composites/WriteDispatch.hxx"
+#include "H5Composites/Writer.hxx"
+
+#include "H5Cpp.h"
+
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace H5Composites {
+    /**
+     * @brief Writes a compound data type in a struct-of-arrays layout
+     *
+     * Rather than a single dataset holding whole rows, a group is created containing one chunked
+     * 1D dataset per leaf member of the compound type (as enumerated by DTypeIterator). Each
+     * dataset is named by the member's full path, e.g. "a.x". The compound type itself is
+     * committed to the group so that ColumnarReader can reassemble the rows.
+     *
+     * Columns hold values of a single type so they compress far better than whole rows, and a
+     * single column can be read without touching the others. Members with variable length data
+     * are not supported.
+     */
+    class ColumnarWriter : public WriteDispatch<ColumnarWriter> {
+    public:
+        /// The name of the committed row data type in the output group
+        static constexpr const char *rowTypeName = "RowType";
+
+        /**
+         * @brief Construct a new ColumnarWriter object
+         *
+         * @param targetGroup The group in which to create the output group
+         * @param name The name of the output group
+         * @param dtype The compound data type to use
+         * @param cacheSize The number of objects to hold in memory before flushing each column
+         * @param chunkSize The number of objects to store per dataset chunk (if -1 chosen by the
+         * options for each column if they request automatic chunking, otherwise set to the
+         * cacheSize)
+         * @param options Filters and chunking options applied to every column
+         */
+        ColumnarWriter(
+                const H5::Group &targetGroup, const std::string &name, const H5::DataType &dtype,
+                std::size_t cacheSize = 2048, std::size_t chunkSize = -1,
+                const DataSetCreationOptions &options = {});
+
+        /// The stored row type
+        const H5::DataType &dtype() const { return m_dtype; }
+
+        /// The output group
+        const H5::Group &group() const { return m_group; }
+
+        /// The number of columns
+        std::size_t nColumns() const { return m_columns.size(); }
+
+        /// The name of each column, which is the full path of the member
+        const std::vector<std::string> &columnNames() const { return m_names; }
+
+        /// The writer for a single column
+        const Writer &column(std::size_t idx) const { return *m_columns.at(idx).writer; }
+
+        /// The number of rows written so far, including those still in the caches
+        hsize_t nRows() const;
+
+        /// Flush all columns to the file
+        void flush();
+
+        /// @brief Write each column to the file from its own background thread
+        /// @param queueDepth The maximum number of full buffers waiting to be written per column
+        ///
+        /// See Writer::startAsyncFlushing
+        void startAsyncFlushing(std::size_t queueDepth = 2);
+
+        /// Wait until all columns have been written, see Writer::sync
+        void sync();
+
+        /**
+         * @brief Write an object contained in a buffer
+         * @param buffer The H5 buffer
+         */
+        void writeFromBuffer(const H5BufferConstView &buffer);
+
+        /**
+         * @brief Write a contiguous array of objects held in a buffer
+         * @param buffer View on the first object
+         * @param n The number of objects
+         *
+         * Up to cacheSize rows at a time are converted to the row type (if necessary) and then
+         * split into the columns.
+         */
+        void writeFromBuffer(const H5BufferConstView &buffer, std::size_t n);
+
+        /// @brief Set a named attribute on the output group
+        /// @param name The attribute name
+        /// @param value The value to set
+        void setAttribute(const std::string &name, const H5BufferConstView &value);
+
+    private:
+        friend class WriteDispatch<ColumnarWriter>;
+
+        struct Column {
+            /// The offset of the member in the row
+            std::size_t offset;
+            std::unique_ptr<Writer> writer;
+        };
+
+        /// @brief Whether objects of the provided type have the same layout as the row type
+        bool isDirectlyWritable(const H5::DataType &dtype) { return m_directCheck(dtype); }
+
+        /// @brief Split a single row with the row type layout into the columns
+        void writeDirect(const void *obj) { writeRows(static_cast<const std::byte *>(obj), 1); }
+
+        /// @brief Split rows with the row type layout into the columns
+        void writeRows(const std::byte *rows, std::size_t n);
+
+        H5::DataType m_dtype;
+        /// Whether data types match the row type
+        DirectWriteCheck m_directCheck;
+        std::size_t m_cacheSize;
+        H5::Group m_group;
+        std::vector<std::string> m_names;
+        std::vector<Column> m_columns;
+        /// Rows converted to the row type
+        SmartBuffer m_rows;
+        /// The values of a single column, gathered from the rows
+        SmartBuffer m_values;
+    };
+} // namespace H5Composites
+
+#endif //> !H5COMPOSITES_COLUMNARWRITER_HXX
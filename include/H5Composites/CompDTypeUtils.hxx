@@ -22,6 +22,7 @@
 
 #include <iterator>
 #include <ranges>
+#include <string>
 #include <vector>
 
 namespace H5Composites {
@@ -65,6 +66,23 @@ namespace H5Composites {
     template <WithH5DType T, std::ranges::input_range Range>
     H5::CompType getCompoundDTypeFromRange(Range &&range);
 
+    /**
+     * @brief Build a compound data type holding only some of the members of another
+     *
+     * @param dtype The full compound data type
+     * @param paths The members to keep. Nested members are given by their full path, e.g. as
+     *        returned by DTypeIterator::fullName
+     * @param sep The separator between the names in each path
+     * @return A packed compound data type containing only the requested members
+     *
+     * Nested compounds in the result only contain the requested sub-members. The members keep the
+     * order that they have in the original data type. As H5 matches compound members by name,
+     * the result can be used as a memory type to read only these members from a dataset.
+     */
+    H5::CompType projectCompoundDType(
+            const H5::CompType &dtype, const std::vector<std::string> &paths,
+            const std::string &sep = ".");
+
     /// Get the names of all elements of this compound data type
     std::vector<std::string> getCompoundElementNames(const H5::CompType &dtype);
 
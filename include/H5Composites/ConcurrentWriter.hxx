@@ -0,0 +1,205 @@
+/**
+ * @file ConcurrentWriter.hxx
+ * @brief Class for writing one-dimensional extendable datasets from several threads
+ */
+
+#ifndef H5COMPOSITES_CONCURRENTWRITER_HXX
+#define H5COMPOSITES_CONCURRENTWRITER_HXX
+
+#include "H5Composites/BufferWriteTraits.hxx"
+#include "H5Composites/DataSetCreationOptions.hxx"
+#include "H5Composites/H5BufferConstView.hxx"
+#include "H5Composites/H5BufferView.hxx"
+#include "H5Composites/SmartBuffer.hxx"
+#include "H5Composites/UnderlyingType.hxx"
+#include "H5Composites/WriteDispatch.hxx"
+
+#include "H5Cpp.h"
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace H5Composites {
+    /**
+     * @brief Writer shared between several producer threads
+     *
+     * Each thread writes through its own @ref Producer, which fills a private staging block
+     * without any locking. Full blocks are handed to a single committer thread which appends them
+     * to the dataset, so the only synchronisation is once per block rather than once per row.
+     *
+     * By default blocks are written in the order in which they arrive. In CommitOrder::Sequence
+     * mode producers instead commit the rows they have written under a sequence number and the
+     * committer writes them in order of sequence number, holding back any that arrive early.
+     * Sequence numbers start from 0 and every one must be committed exactly once, even if no rows
+     * were written for it.
+     *
+     * Writing requires the H5 library to have been built as thread-safe.
+     */
+    class ConcurrentWriter {
+    private:
+        class Committer;
+
+        /// A staging block and the number of rows in it
+        struct Block {
+            SmartBuffer buffer;
+            std::size_t nRows;
+        };
+
+    public:
+        /// The order in which blocks are written to the dataset
+        enum class CommitOrder {
+            Arrival, ///< Blocks are written as soon as they are full
+            Sequence ///< Rows are written in the order of the sequence number they commit with
+        };
+
+        /**
+         * @brief Handle used by a single thread to write to a ConcurrentWriter
+         *
+         * A producer must only be used by one thread at a time and must not outlive the writer
+         * that created it.
+         */
+        class Producer : public WriteDispatch<Producer> {
+        public:
+            /// Move constructor
+            Producer(Producer &&other);
+
+            /// Explicitly disable copying
+            Producer(const Producer &) = delete;
+
+            /// @brief Destructor
+            ///
+            /// In arrival order any rows held are handed to the committer. In sequence order
+            /// uncommitted rows are discarded.
+            ~Producer();
+
+            /// The number of rows written but not yet handed to the committer
+            std::size_t nPending() const;
+
+            /// @brief Hand the current block to the committer
+            /// @exception std::logic_error The writer uses sequence ordering
+            void flush();
+
+            /// @brief Commit all rows written since the last commit under a sequence number
+            /// @param sequence The position of these rows in the output
+            /// @exception std::logic_error The writer does not use sequence ordering
+            /// @exception std::invalid_argument The sequence number was already committed
+            void commit(std::uint64_t sequence);
+
+            /**
+             * @brief Write an object contained in a buffer
+             * @param buffer The H5 buffer
+             */
+            void writeFromBuffer(const H5BufferConstView &buffer);
+
+            /**
+             * @brief Write a contiguous array of objects held in a buffer
+             * @param buffer View on the first object
+             * @param n The number of objects
+             */
+            void writeFromBuffer(const H5BufferConstView &buffer, std::size_t n);
+
+        private:
+            friend class ConcurrentWriter;
+            friend class WriteDispatch<Producer>;
+
+            Producer(Committer &committer, const H5::DataType &dtype, std::size_t blockSize);
+
+            /// @brief Whether objects of the provided type can be copied directly into the block
+            bool isDirectlyWritable(const H5::DataType &dtype) { return m_directCheck(dtype); }
+
+            /// @brief Copy an object with exactly the stored layout into the block
+            void writeDirect(const void *obj) {
+                std::memcpy(nextSlot().get(), obj, m_objectSize);
+                commitSlot();
+            }
+
+            /// @brief Write an object of the stored type which is not simply copied
+            template <BufferWritable T> void writeToSlot(const UnderlyingType_t<T> &obj) {
+                BufferWriteTraits<T>::write(obj, nextSlot());
+                commitSlot();
+            }
+
+            /// @brief The next free slot in the current block
+            H5BufferView nextSlot();
+
+            /// @brief Mark the next free slot as filled, moving on to a new block if it is full
+            void commitSlot();
+
+            /// @brief Replace the current block with an empty one
+            void nextBlock();
+
+            /// @brief Free the vlen data in any blocks that were never handed over
+            void discard();
+
+            Committer *m_committer;
+            H5::DataType m_dtype;
+            /// Whether data types match the stored one
+            DirectWriteCheck m_directCheck;
+            std::size_t m_blockSize;
+            std::size_t m_objectSize;
+            /// The block currently being filled
+            Block m_block;
+            /// Full blocks waiting for the next commit (sequence order only)
+            std::vector<Block> m_full;
+        };
+
+        /**
+         * @brief Construct a new ConcurrentWriter object
+         *
+         * @param targetGroup The group to write to
+         * @param name The name of the dataset to create
+         * @param dtype The data type to use
+         * @param blockSize The number of objects in each producer's staging block
+         * @param chunkSize The number of objects to store per dataset chunk (if -1 chosen by the
+         * options if they request automatic chunking, otherwise set to the blockSize)
+         * @param options Filters and chunking options for the dataset
+         * @param order The order in which rows are written
+         * @param maxQueued In arrival order, the maximum number of blocks waiting to be written
+         * before producers block
+         */
+        ConcurrentWriter(
+                const H5::Group &targetGroup, const std::string &name, const H5::DataType &dtype,
+                std::size_t blockSize = 2048, std::size_t chunkSize = -1,
+                const DataSetCreationOptions &options = {},
+                CommitOrder order = CommitOrder::Arrival, std::size_t maxQueued = 16);
+
+        /// Explicitly disable copying
+        ConcurrentWriter(const ConcurrentWriter &) = delete;
+
+        /// Destructor writes everything that has been handed over to the committer
+        ~ConcurrentWriter();
+
+        /// Create a new producer, to be used by a single thread
+        Producer makeProducer();
+
+        /// @brief Wait until all blocks that can be written have reached the file
+        ///
+        /// In sequence order, blocks waiting on an earlier sequence number are not included.
+        /// Rethrows any error from the committer thread.
+        void sync();
+
+        /// The stored datatype
+        const H5::DataType &dtype() const { return m_dtype; }
+
+        /// The ordering mode
+        CommitOrder order() const { return m_order; }
+
+        /// The underlying dataset
+        const H5::DataSet &dataset() const;
+
+        /// The number of rows written to the dataset so far
+        hsize_t nWritten() const;
+
+    private:
+        H5::DataType m_dtype;
+        std::size_t m_blockSize;
+        CommitOrder m_order;
+        std::unique_ptr<Committer> m_committer;
+    };
+} // namespace H5Composites
+
+#endif //> !H5COMPOSITES_CONCURRENTWRITER_HXX
@@ -4,13 +4,17 @@
 #include "H5Composites/H5Buffer.hxx"
 #include "H5Composites/H5BufferConstView.hxx"
 
+#include <atomic>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <stdexcept>
 #include <string>
 #include <utility>
 #include <vector>
 
 namespace H5Composites {
+    class MemberwiseConverter;
 
     struct ConversionCriteria {
         /// @brief Whether to allow narrowing conversions
@@ -36,6 +40,80 @@ namespace H5Composites {
 
     ConversionStatus checkConversion(const H5::DataType &source, const H5::DataType &target);
 
+    /// @brief Everything about a conversion between two data types that can be worked out once
+    struct ConversionPlan {
+        /// The result of checkConversion for the pair of types
+        ConversionStatus status;
+        /// Whether the H5 converter requires a background buffer
+        H5T_bkg_t needBackground{H5T_BKG_NO};
+        /// The size of the scratch buffer required to convert a single element in place
+        std::size_t scratchSize{0};
+        /// Converter used in place of H5 for simple compound types, null if H5 must be used
+        std::shared_ptr<const MemberwiseConverter> memberwise;
+        /// The source type reduced to the members that the target also has. Reading a dataset as
+        /// this type skips everything that the conversion would discard
+        H5::DataType readDType;
+        /// @brief Converter from readDType to the target, null if H5 should convert while reading
+        ///
+        /// This is never set if readDType holds vlen data, which would have to be reclaimed
+        std::shared_ptr<const MemberwiseConverter> readMemberwise;
+    };
+
+    /**
+     * @brief Thread-safe cache of conversion plans keyed on the (source, target) data type pair
+     *
+     * The cache holds a copy of each data type that it has seen which keeps the underlying H5
+     * identifiers alive, so the identifiers themselves can be used as the key. Data types should
+     * therefore not be modified after they have been used in a conversion.
+     */
+    class ConversionPlanCache {
+    public:
+        /// Get the cache instance
+        static ConversionPlanCache &instance();
+
+        /// @brief Get the plan for converting between two data types, creating it if necessary
+        /// @param source The type being converted from
+        /// @param target The type being converted to
+        std::shared_ptr<const ConversionPlan> get(
+                const H5::DataType &source, const H5::DataType &target);
+
+        /// Remove all cached plans. Does not reset the counters
+        void clear();
+
+        /// The number of cached plans
+        std::size_t size() const;
+
+        /// @brief Set the maximum number of plans to hold
+        ///
+        /// If this is exceeded the cache is cleared. This protects against data types which are
+        /// created dynamically (and so have new identifiers) for each object.
+        void setMaxSize(std::size_t maxSize);
+
+        /// The number of calls to get which found an existing plan
+        std::size_t nHits() const { return m_nHits; }
+
+        /// The number of calls to get which had to create a new plan
+        std::size_t nMisses() const { return m_nMisses; }
+
+        /// Reset the hit and miss counters
+        void resetCounters();
+
+    private:
+        ConversionPlanCache() = default;
+
+        struct Entry {
+            H5::DataType source;
+            H5::DataType target;
+            std::shared_ptr<const ConversionPlan> plan;
+        };
+
+        mutable std::mutex m_mutex;
+        std::map<std::pair<hid_t, hid_t>, Entry> m_plans;
+        std::size_t m_maxSize{1024};
+        std::atomic<std::size_t> m_nHits{0};
+        std::atomic<std::size_t> m_nMisses{0};
+    };
+
     class InvalidConversionError : public std::invalid_argument {
     public:
         InvalidConversionError(
@@ -71,6 +149,23 @@ namespace H5Composites {
     void convert(
             const H5BufferConstView &source, H5BufferView target,
             const ConversionCriteria &criteria = {});
+
+    /**
+     * @brief Convert a contiguous array of elements from the source datatype to the target
+     * datatype
+     * @param source View on the first element of the input data
+     * @param target View on the first element of the output data
+     * @param n The number of elements to convert
+     * @param criteria Criteria to check if the conversion is safe
+     * @exception H5::DataTypeIException The conversion would not be safe
+     *
+     * The conversion is done in a single H5 call with a single background buffer. If source and
+     * target point to the same memory then the conversion is done in place, in which case the
+     * memory must be large enough to hold n elements of the larger of the two types.
+     */
+    void convert(
+            const H5BufferConstView &source, H5BufferView target, std::size_t n,
+            const ConversionCriteria &criteria = {});
 } // namespace H5Composites
 
 #endif //> !H5COMPOSITES_DTYPECONVERSION_HXX
\ No newline at end of file
@@ -0,0 +1,83 @@
+/**
+ * @file DataSetCreationOptions.hxx
+ * @brief Options controlling the filter pipeline of newly created datasets
+ */
+
+#ifndef H5COMPOSITES_DATASETCREATIONOPTIONS_HXX
+#define H5COMPOSITES_DATASETCREATIONOPTIONS_HXX
+
+#include "H5Cpp.h"
+
+#include <vector>
+
+namespace H5Composites {
+    /**
+     * @brief Options used when creating chunked datasets
+     *
+     * Filters are applied in the order shuffle, deflate, any additional filters and finally the
+     * Fletcher32 checksum, so that the checksum covers the compressed data.
+     *
+     * If targetChunkBytes is set then wherever the chunk size is not given explicitly it is
+     * chosen so that each chunk holds roughly that many bytes.
+     */
+    struct DataSetCreationOptions {
+        /// @brief A filter registered with the H5 library by ID
+        struct Filter {
+            /// The filter ID
+            H5Z_filter_t id;
+            /// The auxiliary values passed to the filter
+            std::vector<unsigned int> values{};
+            /// @brief Whether the filter may be skipped
+            ///
+            /// If the filter is not available then optional filters are silently left out of the
+            /// pipeline, otherwise an exception is raised.
+            bool optional{true};
+        };
+
+        /// The ID of the LZF filter
+        static constexpr H5Z_filter_t lzfFilterID = 32000;
+        /// The ID of the Blosc filter
+        static constexpr H5Z_filter_t bloscFilterID = 32001;
+        /// The ID of the Zstandard filter
+        static constexpr H5Z_filter_t zstdFilterID = 32015;
+
+        /// A chunk size in bytes that works well for most use cases
+        static constexpr std::size_t defaultTargetChunkBytes = 512 * 1024;
+
+        /// The target size in bytes of automatically sized chunks, 0 disables automatic chunking
+        std::size_t targetChunkBytes{0};
+        /// The expected number of rows in the dataset (0 if unknown), chunks will not be larger
+        hsize_t expectedRows{0};
+        /// The deflate (gzip) compression level (0-9), a negative value disables deflate
+        int deflateLevel{-1};
+        /// Whether to apply the byte shuffle filter
+        bool shuffle{false};
+        /// Whether to add a Fletcher32 checksum
+        bool fletcher32{false};
+        /// Any additional filters to apply
+        std::vector<Filter> filters{};
+
+        /// @brief Add the filters to a dataset creation property list
+        /// @exception std::runtime_error A non-optional filter is not available
+        void apply(H5::DSetCreatPropList &propList) const;
+
+        /// Whether the chunk size should be chosen automatically
+        bool autoChunk() const { return targetChunkBytes > 0; }
+
+        /// @brief The number of rows to store in each automatically sized chunk
+        /// @param rowSize The size in bytes of a single row
+        hsize_t chunkRows(std::size_t rowSize) const;
+
+        /**
+         * @brief Size the chunk cache of a dataset access property list to match its chunks
+         * @param propList The property list to modify
+         * @param chunkBytes The size of a single chunk in bytes
+         *
+         * The cache is made large enough to hold a few chunks so that partially written chunks
+         * are not repeatedly evicted, and fully written chunks are preferentially evicted.
+         */
+        static void applyChunkCache(H5::DSetAccPropList &propList, std::size_t chunkBytes);
+    };
+} // namespace H5Composites
+
+#endif //> !H5COMPOSITES_DATASETCREATIONOPTIONS_HXX
@@ -0,0 +1,132 @@
+/**
+ * @file DataSetIndex.hxx
+ * @brief Sorted secondary index over one or more columns of a compound dataset
+ */
+
+#ifndef H5COMPOSITES_DATASETINDEX_HXX
+#define H5COMPOSITES_DATASETINDEX_HXX
+
+#include "H5Composites/H5BufferConstView.hxx"
+
+#include "H5Cpp.h"
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace H5Composites {
+    class Reader;
+
+    /**
+     * @brief Index mapping the values of some columns of a dataset to the rows holding them
+     *
+     * The index is stored as a separate dataset next to the data, named with @ref suffix added
+     * to the dataset's name. Each of its rows holds a key and the row in the data that it came
+     * from, sorted by key, so that lookups are binary searches which only read a handful of
+     * blocks.
+     *
+     * Keys may be made from any number of integer, floating point or string members. They are
+     * stored as 64 bit integers, doubles and variable length strings respectively and compared
+     * column by column in the order given. The key columns of the whole dataset are held in
+     * memory while the index is built.
+     */
+    class DataSetIndex {
+    public:
+        /// The suffix added to a dataset's name to give the name of its index
+        static inline const std::string suffix = "_index";
+
+        /**
+         * @brief Build the index for a dataset, replacing any existing one
+         * @param dataset The dataset to index
+         * @param columns The paths of the key members, see projectCompoundDType
+         * @exception std::invalid_argument A column is missing or cannot be used in a key
+         */
+        static void build(const H5::DataSet &dataset, const std::vector<std::string> &columns);
+
+        /**
+         * @brief Build the index for a dataset from the columns set by Writer::setIndex
+         * @exception std::invalid_argument The dataset has no index attribute
+         */
+        static void build(const H5::DataSet &dataset);
+
+        /// @brief Whether a dataset has an index
+        static bool exists(const H5::DataSet &dataset);
+
+        /**
+         * @brief Open the index of a dataset
+         * @param dataset The indexed dataset
+         * @param cacheSize The number of index entries to read at once. If not set will use the
+         *        chunk size of the index
+         * @exception std::invalid_argument The dataset has no index
+         * @exception std::runtime_error The dataset has changed size since the index was built
+         */
+        explicit DataSetIndex(const H5::DataSet &dataset, std::size_t cacheSize = -1);
+
+        ~DataSetIndex();
+
+        /// The key columns
+        const std::vector<std::string> &columns() const { return m_columns; }
+
+        /// The data type of a key
+        const H5::CompType &keyDType() const { return m_keyDType; }
+
+        /// The dataset holding the index
+        const H5::DataSet &dataset() const { return m_index; }
+
+        /**
+         * @brief Find all rows with the given key
+         * @param key One value per key column
+         * @return The matching rows in increasing order
+         */
+        std::vector<std::size_t> equalRange(const std::vector<H5BufferConstView> &key);
+
+        /**
+         * @brief Find the first row with the given key
+         * @param key One value per key column
+         * @return The row or std::nullopt if there is none
+         */
+        std::optional<std::size_t> find(const std::vector<H5BufferConstView> &key);
+
+    private:
+        /// How the values of a key column are compared
+        enum class Kind { Signed, Unsigned, Float, String };
+
+        struct Column {
+            Kind kind;
+            std::size_t offset;
+        };
+
+        /// @brief How to compare a column of the data
+        /// @exception std::invalid_argument The type cannot be used in a key
+        static Kind kindOf(const H5::DataType &dtype);
+
+        /// @brief The data type in which the values of a key column are stored
+        static H5::DataType storedDType(Kind kind);
+
+        /// @brief Compare two keys in the key data type
+        /// @return Negative, zero or positive if lhs is before, equal to or after rhs
+        static int compare(const std::vector<Column> &columns, const void *lhs, const void *rhs);
+
+        /// @brief The position of the first index entry not before (or after) the key
+        /// @param key The key in the key data type
+        /// @param upper Whether to find the first entry after the key
+        std::size_t bound(const void *key, bool upper);
+
+        /// @brief The row of the data referred to by an index entry
+        std::size_t row(std::size_t entry);
+
+        /// @brief Run a binary search for a user provided key
+        /// @return The first and one past the last matching index entries
+        std::pair<std::size_t, std::size_t> search(const std::vector<H5BufferConstView> &key);
+
+        H5::DataSet m_index;
+        std::unique_ptr<Reader> m_reader;
+        std::vector<std::string> m_columns;
+        std::vector<Column> m_keyColumns;
+        H5::CompType m_keyDType;
+        std::size_t m_rowOffset;
+    };
+} // namespace H5Composites
+
+#endif //> !H5COMPOSITES_DATASETINDEX_HXX
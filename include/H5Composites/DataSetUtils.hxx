@@ -12,6 +12,8 @@
 #ifndef H5COMPOSITES_DATASETUTILS_HXX
 #define H5COMPOSITES_DATASETUTILS_HXX
 
+#include "H5Composites/DataSetCreationOptions.hxx"
+
 #include "H5Cpp.h"
 #include <utility>
 #include <vector>
@@ -37,27 +39,62 @@ namespace H5Composites {
      * @param nRowsInBuffer The number of rows to hold in the internal buffer
      * @return The new position in the target dataset
      *
-     * The dimensions and datatypes of the datasets must be compatible
+     * The dimensions and datatypes of the datasets must be compatible.
+     *
+     * If both datasets have the same data type, chunk shape and filter pipeline and the current
+     * position lies on a chunk boundary then whole chunks are copied without being decompressed.
+     * Only the final partial chunk (if any) goes through the normal read and write.
      */
     hsize_t extendDataSet(
             H5::DataSet &target, const H5::DataSet &source, hsize_t mergeAxis,
             hsize_t currentPosition, std::size_t nRowsInBuffer);
 
+    /**
+     * @brief Copy the data from several source datasets to consecutive positions in the target
+     *
+     * @param target The dataset to hold the new rows
+     * @param sources The datasets to take the rows from, in order
+     * @param mergeAxis The axis along which to increase
+     * @param currentPosition The current position along the merge axis in the target dataset
+     * @param nRowsInBuffer The number of rows to hold in each internal buffer
+     * @param nThreads The number of threads reading from the sources. If 0 then everything is done
+     *        in the calling thread.
+     * @return The new position in the target dataset
+     *
+     * When using threads, blocks are read (and converted) from the sources ahead of time while the
+     * calling thread writes them to the target in their original order, so the output does not
+     * depend on the number of threads. This requires a thread-safe build of the H5 library.
+     *
+     * The H5 library serialises its own calls, so the threads gain nothing on the reads and
+     * writes themselves, including any decompression. Only conversions that a
+     * MemberwiseConverter can do are moved out of H5 and onto the reader threads, where they run
+     * alongside the I/O. Sources already in the target type, or needing a conversion only H5 can
+     * do, will not be any faster with threads.
+     */
+    hsize_t extendDataSet(
+            H5::DataSet &target, const std::vector<H5::DataSet> &sources, hsize_t mergeAxis,
+            hsize_t currentPosition, std::size_t nRowsInBuffer, std::size_t nThreads);
+
     /**
      * @brief Merge the provided datasets into a new dataset in the target group
      *
      * @param targetGroup Place to put the new dataset
      * @param name The name of the new dataset
      * @param datasets The input datasets
-     * @param maxBufferSize The maximum size to use for the buffer (default=10kB)
+     * @param maxBufferSize The maximum size to use for each buffer (default=1MB)
      * @param defaultMergeAxis The default merge axis
+     * @param options Filters and chunking options for the new dataset
+     * @param nThreads The number of threads to read the inputs with, see @ref extendDataSet
      *
-     * The max buffer size will also be used as the chunk size
+     * Unless the options request automatic chunking the max buffer size will also be used as the
+     * chunk size. When chunking automatically the expected number of rows defaults to the size of
+     * the merged dataset.
      */
     void mergeDataSets(
             H5::Group &targetGroup, const std::string &name,
-            const std::vector<H5::DataSet> &datasets, std::size_t maxBufferSize = 10 * 1024,
-            hsize_t defaultMergeAxis = 0);
+            const std::vector<H5::DataSet> &datasets, std::size_t maxBufferSize = 1024 * 1024,
+            hsize_t defaultMergeAxis = 0, const DataSetCreationOptions &options = {},
+            std::size_t nThreads = 0);
 
 } // namespace H5Composites
 
@@ -2,6 +2,8 @@
 #define H5COMPOSITES_GROUPWRAPPER_HXX
 
 #include "H5Composites/BufferConstructTraits.hxx"
+#include "H5Composites/ColumnarReader.hxx"
+#include "H5Composites/ColumnarWriter.hxx"
 #include "H5Composites/H5Buffer.hxx"
 #include "H5Composites/TypeRegister.hxx"
 #include "H5Composites/TypedWriter.hxx"
@@ -41,6 +43,33 @@ namespace H5Composites {
          */
         static GroupWrapper createFile(const std::string &name, bool overwrite = false);
 
+#ifdef H5_HAVE_PARALLEL
+        /**
+         * @brief Open a file for reading on every rank of an MPI communicator
+         * @param name The name of the file
+         * @param comm The communicator, every rank of which must make this call
+         * @param info Hints for the MPI-IO layer
+         * @param update If true, open the file in read/write mode, otherwise read only
+         */
+        static GroupWrapper readFile(
+                const std::string &name, MPI_Comm comm, MPI_Info info = MPI_INFO_NULL,
+                bool update = false);
+
+        /**
+         * @brief Create a new file on every rank of an MPI communicator
+         * @param name The name of the file
+         * @param comm The communicator, every rank of which must make this call
+         * @param info Hints for the MPI-IO layer
+         * @param overwrite If true, overwrite any existing file, otherwise an existing file will
+         *                  cause this call to fail
+         *
+         * Writers in the file can then write collectively, see Writer::useCollectiveIO.
+         */
+        static GroupWrapper createFile(
+                const std::string &name, MPI_Comm comm, MPI_Info info = MPI_INFO_NULL,
+                bool overwrite = false);
+#endif
+
         /// @brief Helper to check if a file contains an instance of the type register
         static bool hasTypeRegister(const H5::Group &group);
 
@@ -87,14 +116,43 @@ namespace H5Composites {
         /// See @ref TypedWriter documentation for the meaning of the parameters
         template <WithStaticH5DType T>
         TypedWriter<T> makeDataSetWriter(
-                const std::string &name, std::size_t cacheSize = 2048, std::size_t chunkSize = -1);
+                const std::string &name, std::size_t cacheSize = 2048, std::size_t chunkSize = -1,
+                const DataSetCreationOptions &options = {});
 
         /// @brief Create a new dataset writer
         ///
         /// See @ref Writer documentation for the meaning of the parameters
         Writer makeDataSetWriter(
                 const std::string &name, const H5::DataType &dtype, std::size_t cacheSize = 2048,
-                std::size_t chunkSize = -1);
+                std::size_t chunkSize = -1, const DataSetCreationOptions &options = {});
+
+        /// @brief Create a new writer storing each member in its own dataset
+        ///
+        /// See @ref ColumnarWriter documentation for the meaning of the parameters
+        template <WithStaticH5DType T>
+        ColumnarWriter makeColumnarWriter(
+                const std::string &name, std::size_t cacheSize = 2048, std::size_t chunkSize = -1,
+                const DataSetCreationOptions &options = {});
+
+        /// @brief Create a new writer storing each member in its own dataset
+        ///
+        /// See @ref ColumnarWriter documentation for the meaning of the parameters
+        ColumnarWriter makeColumnarWriter(
+                const std::string &name, const H5::DataType &dtype, std::size_t cacheSize = 2048,
+                std::size_t chunkSize = -1, const DataSetCreationOptions &options = {});
+
+        /// @brief Read a group written by a ColumnarWriter
+        ///
+        /// See @ref ColumnarReader documentation for the meaning of the parameters
+        ColumnarReader makeColumnarReader(
+                const std::string &name, std::size_t cacheSize = -1) const;
+
+        /// @brief Read some members from a group written by a ColumnarWriter
+        ///
+        /// See @ref ColumnarReader documentation for the meaning of the parameters
+        ColumnarReader makeColumnarReader(
+                const std::string &name, const std::vector<std::string> &members,
+                std::size_t cacheSize = -1) const;
 
     private:
         H5::Group m_group;
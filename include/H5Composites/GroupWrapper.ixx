@@ -18,8 +18,16 @@ namespace H5Composites {
 
     template <WithStaticH5DType T>
     TypedWriter<T> GroupWrapper::makeDataSetWriter(
-            const std::string &name, std::size_t cacheSize, std::size_t chunkSize) {
-        return TypedWriter<T>(m_group, name, cacheSize, chunkSize);
+            const std::string &name, std::size_t cacheSize, std::size_t chunkSize,
+            const DataSetCreationOptions &options) {
+        return TypedWriter<T>(m_group, name, cacheSize, chunkSize, options);
+    }
+
+    template <WithStaticH5DType T>
+    ColumnarWriter GroupWrapper::makeColumnarWriter(
+            const std::string &name, std::size_t cacheSize, std::size_t chunkSize,
+            const DataSetCreationOptions &options) {
+        return ColumnarWriter(m_group, name, getH5DType<T>(), cacheSize, chunkSize, options);
     }
 
 } // namespace H5Composites
\ No newline at end of file
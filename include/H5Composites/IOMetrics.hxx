@@ -0,0 +1,140 @@
+/**
+ * @file IOMetrics.hxx
+ * @brief Counters and timers recording where time goes inside the readers and writers
+ */
+
+#ifndef H5COMPOSITES_IOMETRICS_HXX
+#define H5COMPOSITES_IOMETRICS_HXX
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <set>
+
+namespace H5Composites {
+    /// @brief A snapshot of the work done by a Writer or Reader
+    ///
+    /// Rows and bytes count what was written to or read from the dataset, with bytes measured in
+    /// the memory layout (excluding any vlen data). A block is a single flush of a writer or a
+    /// single refill of a reader's cache.
+    struct IOMetrics {
+        std::uint64_t rows{0};
+        std::uint64_t bytes{0};
+        std::uint64_t blocks{0};
+        /// Time spent converting rows outside of H5
+        std::chrono::nanoseconds conversionTime{0};
+        /// Time spent in the H5 read and write calls, including any conversion H5 performs
+        std::chrono::nanoseconds ioTime{0};
+        /// Time spent extending the dataset
+        std::chrono::nanoseconds extendTime{0};
+        /// Time spent freeing vlen memory
+        std::chrono::nanoseconds reclaimTime{0};
+
+        IOMetrics &operator+=(const IOMetrics &other);
+    };
+
+    /// @brief Called with the current metrics after each block
+    using IOMetricsCallback = std::function<void(const IOMetrics &)>;
+
+    /**
+     * @brief Accumulates the metrics of a single Writer or Reader
+     *
+     * All updates are atomic so a recorder may be shared with background threads. Every recorder
+     * is known to the MetricsRegistry for the lifetime of the recorder.
+     */
+    class IOMetricsRecorder {
+    public:
+        /// The kind of object whose work is recorded
+        enum class Source { Writer, Reader };
+
+        /// The operations which are timed
+        enum class Timer { Conversion, IO, Extend, Reclaim };
+
+        /// Adds the time until destruction to one of the timers
+        class Scope {
+        public:
+            Scope(IOMetricsRecorder &recorder, Timer timer)
+                    : m_recorder(recorder), m_timer(timer),
+                      m_start(std::chrono::steady_clock::now()) {}
+
+            ~Scope() { m_recorder.addTime(m_timer, std::chrono::steady_clock::now() - m_start); }
+
+        private:
+            IOMetricsRecorder &m_recorder;
+            Timer m_timer;
+            std::chrono::steady_clock::time_point m_start;
+        };
+
+        explicit IOMetricsRecorder(Source source);
+
+        /// Explicitly disable copying
+        IOMetricsRecorder(const IOMetricsRecorder &) = delete;
+
+        ~IOMetricsRecorder();
+
+        Source source() const { return m_source; }
+
+        /// Record a block of rows
+        void addBlock(std::uint64_t rows, std::uint64_t bytes) {
+            m_rows.fetch_add(rows, std::memory_order_relaxed);
+            m_bytes.fetch_add(bytes, std::memory_order_relaxed);
+            m_blocks.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        /// Add to one of the timers
+        void addTime(Timer timer, std::chrono::nanoseconds time) {
+            m_times[static_cast<std::size_t>(timer)].fetch_add(
+                    time.count(), std::memory_order_relaxed);
+        }
+
+        /// The current values
+        IOMetrics snapshot() const;
+
+        /// Set everything back to 0
+        void reset();
+
+    private:
+        Source m_source;
+        std::atomic<std::uint64_t> m_rows{0};
+        std::atomic<std::uint64_t> m_bytes{0};
+        std::atomic<std::uint64_t> m_blocks{0};
+        std::array<std::atomic<std::int64_t>, 4> m_times{};
+    };
+
+    /**
+     * @brief Aggregates the metrics of every Writer and Reader in the process
+     *
+     * The totals include both live objects and those that have already been destroyed.
+     */
+    class MetricsRegistry {
+    public:
+        /// Get the registry instance
+        static MetricsRegistry &instance();
+
+        /// The sum over all recorders of one kind
+        IOMetrics totals(IOMetricsRecorder::Source source) const;
+
+        /// The number of live recorders of one kind
+        std::size_t nLive(IOMetricsRecorder::Source source) const;
+
+        /// Forget about destroyed recorders and reset the live ones
+        void reset();
+
+    private:
+        friend class IOMetricsRecorder;
+
+        MetricsRegistry() = default;
+
+        void add(IOMetricsRecorder *recorder);
+        void remove(IOMetricsRecorder *recorder);
+
+        mutable std::mutex m_mutex;
+        std::array<std::set<IOMetricsRecorder *>, 2> m_live;
+        std::array<IOMetrics, 2> m_retired;
+    };
+} // namespace H5Composites
+
+#endif //> !H5COMPOSITES_IOMETRICS_HXX
@@ -0,0 +1,92 @@
+/**
+ * @file MemberwiseConverter.hxx
+ * @brief Fast conversion between compound types built from native numeric members
+ */
+
+#ifndef H5COMPOSITES_MEMBERWISECONVERTER_HXX
+#define H5COMPOSITES_MEMBERWISECONVERTER_HXX
+
+#include "H5Cpp.h"
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace H5Composites {
+    /**
+     * @brief Converts blocks of compound objects member by member without going through H5
+     *
+     * This handles the common schema evolution cases for structs: members that are reordered,
+     * added, removed or changed between native numeric types. The layout of both types is read
+     * once to create a list of steps, each with fixed source and target offsets. Numeric members
+     * are converted by a cast function instantiated at compile time for that pair of types, and
+     * identical members are copied directly. Members that are only in the target are zeroed, as
+     * H5 does.
+     *
+     * Conversions to integer types saturate at the limits of the target type, and NaNs become 0.
+     *
+     * Plain numeric types and arrays of them are handled in the same way, as are numeric types
+     * that only differ in their byte order. Values that are contiguous in memory are converted
+     * by loops which the compiler can vectorise. On x86 there are also explicit AVX2/AVX-512
+     * kernels for float <-> double, int64 -> int32 and byte swapping, chosen at runtime from the
+     * instruction sets that the CPU supports.
+     */
+    class MemberwiseConverter {
+    public:
+        /**
+         * @brief Create a converter for a pair of types
+         * @return The converter, or nullptr if it cannot handle these types
+         *
+         * Every member shared with the source must be a native numeric type (in either byte
+         * order), an array of these or a compound made from them. The types themselves can also
+         * be numeric or arrays. Members which are identical in both types can be anything without
+         * variable length data.
+         */
+        static std::unique_ptr<MemberwiseConverter> create(
+                const H5::DataType &source, const H5::DataType &target);
+
+        /// @brief Convert n objects. The source and target memory must not overlap
+        void operator()(const void *source, void *target, std::size_t n) const;
+
+        /// @brief The size of a single source object
+        std::size_t sourceSize() const { return m_sourceSize; }
+
+        /// @brief The size of a single target object
+        std::size_t targetSize() const { return m_targetSize; }
+
+        /// @brief The number of steps run for each object
+        std::size_t nSteps() const { return m_steps.size(); }
+
+        /// Function converting n values between strided locations
+        using Kernel = void (*)(
+                const std::byte *source, std::size_t sourceStride, std::byte *target,
+                std::size_t targetStride, std::size_t n);
+
+    private:
+        struct Step {
+            std::size_t sourceOffset;
+            std::size_t targetOffset;
+            /// The number of bytes written to the target
+            std::size_t size;
+            /// The conversion function, if null then bytes are copied from the source
+            Kernel kernel{nullptr};
+            /// If set, the target bytes are zeroed
+            bool zero{false};
+        };
+
+        MemberwiseConverter(std::size_t sourceSize, std::size_t targetSize);
+
+        bool addSteps(
+                const H5::DataType &source, std::size_t sourceOffset, const H5::DataType &target,
+                std::size_t targetOffset);
+
+        /// Sort the steps, merge neighbouring copies and fill the gaps with zeroes
+        void finalise();
+
+        std::size_t m_sourceSize;
+        std::size_t m_targetSize;
+        std::vector<Step> m_steps;
+    };
+} // namespace H5Composites
+
+#endif //> !H5COMPOSITES_MEMBERWISECONVERTER_HXX
@@ -0,0 +1,184 @@
+/**
+ * @file ParallelScan.hxx
+ * @brief Process every row of a single dataset on several threads
+ */
+
+#ifndef H5COMPOSITES_PARALLELSCAN_HXX
+#define H5COMPOSITES_PARALLELSCAN_HXX
+
+#include "H5Composites/BufferConstructTraits.hxx"
+#include "H5Composites/H5BufferConstView.hxx"
+#include "H5Composites/IOMetrics.hxx"
+#include "H5Composites/SmartBuffer.hxx"
+#include "H5Composites/UnderlyingType.hxx"
+
+#include "H5Cpp.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <vector>
+
+namespace H5Composites {
+    /**
+     * @brief Splits a dataset into blocks which are processed by a pool of worker threads
+     *
+     * Blocks are whole numbers of chunks so no chunk is decoded twice. A single I/O thread reads
+     * the blocks in order, as the H5 library only runs one call at a time anyway, while the
+     * workers convert them to the requested data type and pass them to the user's callback.
+     * Where the conversion can be done outside of H5 it is left to the workers so that it runs in
+     * parallel with the next read. Each worker keeps its own cache for the converted rows.
+     *
+     * Blocks are handed to whichever worker is free so callbacks see them in no particular order
+     * and several callbacks run at once. Any exception thrown from a callback stops the scan and
+     * is rethrown from the calling thread.
+     *
+     * With workers this requires a thread-safe build of the H5 library.
+     */
+    class ParallelScan {
+    public:
+        /**
+         * @brief Called with a block of consecutive rows
+         * @param worker The index of the worker making the call, below nWorkers()
+         * @param first The index of the first row in the dataset
+         * @param rows View on the first row
+         * @param n The number of rows
+         *
+         * The rows are only valid for the duration of the call.
+         */
+        using BlockCallback = std::function<void(
+                std::size_t worker, std::size_t first, const H5BufferConstView &rows,
+                std::size_t n)>;
+
+        /**
+         * @brief Called with a single row
+         * @param worker The index of the worker making the call, below nWorkers()
+         * @param row The index of the row in the dataset
+         * @param obj View on the row
+         */
+        using RowCallback = std::function<void(
+                std::size_t worker, std::size_t row, const H5BufferConstView &obj)>;
+
+        /**
+         * @brief Create a new scan
+         * @param dtype The dtype to read as
+         * @param dataset The dataset to scan
+         * @param nWorkers The number of worker threads. If 0 everything is done in the calling
+         *        thread
+         * @param blockSize The number of rows in each block, rounded up to a whole number of
+         *        chunks. If not set will use the dataset's chunk size.
+         * @param nBuffers The number of blocks that may be read but not yet converted. If not set
+         *        will use twice the number of workers.
+         * @exception std::runtime_error Workers were requested but the H5 library is not
+         *            thread-safe
+         */
+        ParallelScan(
+                const H5::DataType &dtype, const H5::DataSet &dataset, std::size_t nWorkers,
+                std::size_t blockSize = -1, std::size_t nBuffers = -1);
+
+        /// Explicitly disable copying
+        ParallelScan(const ParallelScan &) = delete;
+
+        ~ParallelScan();
+
+        /// The data type that the rows are read as
+        const H5::DataType &dtype() const { return m_dtype; }
+
+        /// The dataset being scanned
+        const H5::DataSet &dataset() const { return m_dataset; }
+
+        /// The number of worker threads
+        std::size_t nWorkers() const { return m_nWorkers; }
+
+        /// The number of rows in each block
+        std::size_t blockSize() const { return m_blockSize; }
+
+        /// The number of rows in the dataset
+        std::size_t nRows() const { return m_nRows; }
+
+        /// @brief Call a function on every block of the dataset
+        void forEachBlock(const BlockCallback &callback);
+
+        /// @brief Call a function on every row of the dataset
+        void forEach(const RowCallback &callback);
+
+        /// @brief Call a function on every row of the dataset, read as the specified type
+        template <BufferConstructible T>
+        void forEach(
+                const std::function<void(
+                        std::size_t worker, std::size_t row, const UnderlyingType_t<T> &obj)>
+                        &callback) {
+            forEach([&callback](std::size_t worker, std::size_t row, const H5BufferConstView &obj) {
+                callback(worker, row, fromBuffer<T>(obj));
+            });
+        }
+
+        /**
+         * @brief Fold every block of the dataset into a single value
+         * @param init The starting value for each worker
+         * @param accumulate Called as accumulate(state, first, rows, n) to add a block to a
+         *        worker's state
+         * @param combine Called as combine(lhs, rhs) to merge the states of two workers
+         * @return The combined state of all workers
+         *
+         * As blocks are spread across workers in no fixed order, combine should be associative
+         * and commutative for the result to be reproducible.
+         */
+        template <typename State, typename Accumulate, typename Combine>
+        State reduce(const State &init, Accumulate &&accumulate, Combine &&combine) {
+            // Each worker has its own state so the accumulation needs no locking
+            std::vector<std::optional<State>> states(std::max<std::size_t>(m_nWorkers, 1), init);
+            forEachBlock([&](std::size_t worker, std::size_t first, const H5BufferConstView &rows,
+                             std::size_t n) { accumulate(*states[worker], first, rows, n); });
+            State result = std::move(*states.front());
+            for (std::size_t idx = 1; idx < states.size(); ++idx)
+                result = combine(std::move(result), std::move(*states[idx]));
+            return result;
+        }
+
+        /// @brief The work done by the scan so far
+        IOMetrics metrics() const { return m_metrics->snapshot(); }
+
+        /// @brief Set all metrics back to 0
+        void resetMetrics() { m_metrics->reset(); }
+
+    private:
+        /// A block read from the file but not yet processed
+        struct Block {
+            std::size_t first;
+            std::size_t nRows;
+            SmartBuffer buffer;
+        };
+
+        /// @brief Read a block of rows in the read data type
+        void read(Block &block);
+
+        /// @brief Convert a block and pass it to the callback
+        /// @return The block's buffer, now holding no vlen data
+        SmartBuffer process(std::size_t worker, Block &&block, const BlockCallback &callback);
+
+        /// @brief Free the vlen data held in a buffer
+        void reclaim(const H5::DataType &dtype, void *buffer, std::size_t nRows);
+
+        /// @brief Get an empty buffer for a block
+        SmartBuffer makeBuffer();
+
+        H5::DataType m_dtype;
+        H5::DataSet m_dataset;
+        /// The data type blocks are read as, either the file's or the requested one
+        H5::DataType m_readDType;
+        std::size_t m_nWorkers;
+        std::size_t m_blockSize;
+        std::size_t m_nBuffers;
+        std::size_t m_nRows;
+        /// Empty buffers in the read data type, kept between scans
+        std::vector<SmartBuffer> m_buffers;
+        /// The cache of each worker, used when the rows have to be converted
+        std::vector<SmartBuffer> m_caches;
+        std::unique_ptr<IOMetricsRecorder> m_metrics;
+    };
+} // namespace H5Composites
+
+#endif //> !H5COMPOSITES_PARALLELSCAN_HXX
@@ -2,20 +2,54 @@
 #define H5COMPOSITES_READER_HXX
 
 #include "H5Composites/BufferConstructTraits.hxx"
+#include "H5Composites/BufferWriteTraits.hxx"
 #include "H5Composites/H5BufferConstView.hxx"
+#include "H5Composites/H5BufferView.hxx"
+#include "H5Composites/IOMetrics.hxx"
 #include "H5Composites/SmartBuffer.hxx"
 #include "H5Composites/UnderlyingType.hxx"
+#include "H5Composites/VLenArena.hxx"
 
 #include "H5Cpp.h"
 
+#include <algorithm>
+#include <list>
+#include <map>
+#include <memory>
 #include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
 
 namespace H5Composites {
+    class DataSetIndex;
+
+    /// Whether a set of arguments are the individual values of an index key
+    template <typename... Ts>
+    concept IndexKey =
+            !(sizeof...(Ts) == 1 && (std::same_as<Ts, std::vector<H5BufferConstView>> && ...));
+
     /// @brief Object to read elements of a dataset one by one
     ///
-    /// NB: Right now this only handles 1D datasets
+    /// NB: Right now this only handles 1D datasets. The cache is allocated with
+    /// BufferAllocator::cache()
+    ///
+    /// Besides reading forwards through the dataset, arbitrary rows can be read with @ref read and
+    /// @ref readRange. These go through a separate least-recently-used cache of blocks which are
+    /// aligned to the dataset's chunks, so that revisiting nearby rows does not touch the file.
     class Reader {
     public:
+        /// The cache size used for datasets that are not chunked, if none is given
+        static constexpr std::size_t defaultCacheSize = 2048;
+
+        /// @brief How rows of a memory mapped dataset are expected to be visited
+        enum class AccessPattern {
+            Sequential, ///< Forwards through the dataset, the next cache block is read ahead
+            Random,     ///< Scattered rows, the kernel does not read ahead
+            Resident    ///< The whole dataset is loaded up front and revisited often
+        };
+
         /// @brief Create a new reader object
         /// @param dtype The dtype to read as
         /// @param dataset The dataset from which to read
@@ -27,9 +61,75 @@ namespace H5Composites {
         /// @param cacheSize The number of objects to read into the cache at once. If not set will
         ///        use the dataset's chunk size.
         Reader(const H5::DataSet &dataset, std::size_t cacheSize = -1);
+        /// @brief Create a reader that only reads some members of a compound dataset
+        /// @param dataset The dataset from which to read
+        /// @param members The paths of the members to read, see projectCompoundDType
+        /// @param cacheSize The number of objects to read into the cache at once. If not set will
+        ///        use the dataset's chunk size.
+        ///
+        /// Only the selected members are converted and copied out of the file so the cache size
+        /// and the cost per row depend on the selection rather than on the full data type.
+        Reader(const H5::DataSet &dataset, const std::vector<std::string> &members,
+               std::size_t cacheSize = -1);
 
         ~Reader();
 
+        /// @brief Read ahead in a background thread
+        /// @param nBuffers The number of cache blocks to hold in memory, must be at least 2
+        ///
+        /// While the current cache block is being consumed the following ones are read by a
+        /// separate thread. This requires the H5 library to have been built as thread-safe. Any
+        /// error in the background thread is rethrown by the next read call that needs it.
+        void startPrefetching(std::size_t nBuffers = 2);
+
+        /// @brief Whether the reader is prefetching blocks in a background thread
+        bool isPrefetching() const { return m_prefetcher != nullptr; }
+
+        /// @brief Allocate the vlen data read into each cache block from an arena
+        /// @param blockSize The minimum size of the memory blocks in the arena
+        ///
+        /// The arena is reset on each refill of the cache rather than every element being freed
+        /// separately. This must be called before anything is read and before
+        /// @ref startPrefetching.
+        void useVLenArena(std::size_t blockSize = VLenArena::defaultBlockSize);
+
+        /// @brief Whether vlen data in the cache is allocated from an arena
+        bool usesVLenArena() const { return m_arena != nullptr; }
+
+        /**
+         * @brief Read rows straight out of a memory mapping of the file
+         * @param pattern The expected access pattern, passed on to the kernel as a hint
+         * @return Whether the dataset could be mapped. If not nothing changes
+         * @exception std::logic_error The reader is prefetching
+         *
+         * This is only possible for datasets stored contiguously and without filters in a file
+         * using the default driver, when the read data type is identical to the stored one and
+         * holds no vlen data. Every view returned by the reader then points directly into the
+         * mapping so nothing is copied and the pages are shared with any other process reading
+         * the same file. The cache size still sets how far ahead sequential reads are hinted.
+         * The dataset must not be modified while it is mapped.
+         */
+        bool useMemoryMap(AccessPattern pattern = AccessPattern::Sequential);
+
+        /// @brief Whether rows are read from a memory mapping
+        bool isMemoryMapped() const { return m_map != nullptr; }
+
+        /// @brief The work done by this reader so far
+        ///
+        /// Blocks read by a prefetching thread are included as soon as they have been read. When
+        /// H5 converts the rows as part of the read the conversion is included in the I/O time.
+        IOMetrics metrics() const { return m_metrics->snapshot(); }
+
+        /// @brief Set all metrics back to 0
+        void resetMetrics() { m_metrics->reset(); }
+
+        /// @brief Set a function to be called with the current metrics after each refill
+        ///
+        /// The callback is always called from the thread that owns the reader
+        void setMetricsCallback(IOMetricsCallback callback) {
+            m_metricsCallback = std::move(callback);
+        }
+
         /// @brief The type read out into the cache
         const H5::DataType &dtype() const { return m_dtype; }
 
@@ -52,11 +152,180 @@ namespace H5Composites {
                 return std::nullopt;
         }
 
+        /// @brief Read up to n contiguous rows of the dataset
+        /// @param n The maximum number of rows to read
+        /// @return A view of an array holding the rows
+        ///
+        /// The view only covers rows that are already in the cache (refilling it first if it is
+        /// empty) so may hold fewer than n rows. An empty view is returned when the dataset is
+        /// exhausted. Note that subsequent calls to next are allowed to modify this memory.
+        H5BufferConstView nextBlock(std::size_t n);
+
+        /// @brief Read the next rows of the dataset into user memory
+        /// @param buffer View on the first element of the memory to fill
+        /// @param n The number of elements to read
+        /// @return The number of elements read, less than n if the dataset is exhausted
+        ///
+        /// Any rows left in the cache are converted into the memory first, the rest are read with
+        /// a single H5 read call straight into the provided memory.
+        std::size_t readInto(H5BufferView buffer, std::size_t n);
+
+        /// @brief Read the next rows of the dataset into user memory
+        /// @return The number of objects read, less than the size of the span if the dataset is
+        ///         exhausted
+        template <BufferConstructible T>
+            requires(!WrapperTrait<T>)
+        std::size_t readInto(std::span<T> objs) {
+            if constexpr (BufferReadIsCopy<T> && WithStaticH5DType<T>)
+                return readInto(H5BufferView(objs.data(), getH5DType<T>()), objs.size());
+            else {
+                for (std::size_t idx = 0; idx < objs.size(); ++idx) {
+                    if (std::optional<T> obj = next<T>())
+                        objs[idx] = std::move(*obj);
+                    else
+                        return idx;
+                }
+                return objs.size();
+            }
+        }
+
         /// @brief The number of elements remining to be read
         std::size_t nRemaining() const { return m_nRemainingInDS; }
 
+        /// @brief The total number of rows in the dataset
+        std::size_t size() const { return m_nRows; }
+
+        /// @brief The row that the next call to next will return
+        std::size_t position() const {
+            return m_offset - m_nInCache + std::min<std::size_t>(m_cachePosition, m_nInCache);
+        }
+
+        /// @brief Move the read position so that the next call to next returns the given row
+        /// @param row The row to move to, may be one past the end of the dataset
+        /// @exception std::out_of_range The row is beyond the end of the dataset
+        /// @exception std::logic_error The reader is prefetching
+        ///
+        /// If the row is already in the cache then nothing is read, otherwise the cache is
+        /// refilled starting from that row on the next read.
+        void seek(std::size_t row);
+
+        /// @brief Read a single row by its index
+        /// @param row The index of the row
+        /// @return A view of the row, valid until the block holding it leaves the block cache
+        /// @exception std::out_of_range The row is beyond the end of the dataset
+        ///
+        /// This does not change the position used by next.
+        H5BufferConstView read(std::size_t row);
+
+        /// @brief Read a single row by its index as the specified type
+        template <BufferConstructible T> UnderlyingType_t<T> read(std::size_t row) {
+            return fromBuffer<T>(read(row));
+        }
+
+        /// @brief Read a range of rows into user memory
+        /// @param first The first row to read
+        /// @param buffer View on the first element of the memory to fill
+        /// @param n The number of rows to read
+        /// @return The number of rows read, less than n if the range passes the end of the dataset
+        /// @exception std::out_of_range The first row is beyond the end of the dataset
+        ///
+        /// This does not change the position used by next.
+        std::size_t readRange(std::size_t first, H5BufferView buffer, std::size_t n);
+
+        /// @brief Read a range of rows as the specified type
+        /// @param first The first row to read
+        /// @param n The maximum number of rows to read
+        template <BufferConstructible T>
+            requires(!WrapperTrait<T>)
+        std::vector<T> readRange(std::size_t first, std::size_t n) {
+            if (first > m_nRows)
+                throw std::out_of_range(
+                        "Row " + std::to_string(first) + " is beyond the end of the dataset");
+            std::vector<T> values;
+            n = std::min(n, m_nRows - first);
+            if constexpr (BufferReadIsCopy<T> && WithStaticH5DType<T>) {
+                values.resize(n);
+                readRange(first, H5BufferView(values.data(), getH5DType<T>()), n);
+            } else {
+                values.reserve(n);
+                for (std::size_t idx = 0; idx < n; ++idx)
+                    values.push_back(read<T>(first + idx));
+            }
+            return values;
+        }
+
+        /// @brief Find all rows with the given key in the dataset's index
+        /// @param key One value per key column
+        /// @return The matching rows in increasing order
+        /// @exception std::invalid_argument The dataset has no index
+        ///
+        /// See DataSetIndex. The index is opened on first use.
+        std::vector<std::size_t> equalRange(const std::vector<H5BufferConstView> &key);
+
+        /// @brief Find all rows with the given key in the dataset's index
+        template <typename... Ts>
+            requires(sizeof...(Ts) > 0 && IndexKey<Ts...> && (BufferWritable<Ts> && ...))
+        std::vector<std::size_t> equalRange(const Ts &...key) {
+            return equalRange(std::vector<H5BufferConstView>{toBuffer(key)...});
+        }
+
+        /// @brief Find the first row with the given key in the dataset's index
+        /// @param key One value per key column
+        /// @return The row or std::nullopt if there is none
+        /// @exception std::invalid_argument The dataset has no index
+        std::optional<std::size_t> find(const std::vector<H5BufferConstView> &key);
+
+        /// @brief Find the first row with the given key in the dataset's index
+        template <typename... Ts>
+            requires(sizeof...(Ts) > 0 && IndexKey<Ts...> && (BufferWritable<Ts> && ...))
+        std::optional<std::size_t> find(const Ts &...key) {
+            return find(std::vector<H5BufferConstView>{toBuffer(key)...});
+        }
+
+        /// @brief The number of rows in each block of the block cache
+        std::size_t blockRows() const { return m_blockRows; }
+
+        /// @brief Set the maximum number of blocks held for random access
+        ///
+        /// Any views returned by @ref read may be invalidated
+        void setBlockCacheSize(std::size_t nBlocks);
+
+        /// @brief The maximum number of blocks held for random access
+        std::size_t blockCacheSize() const { return m_blockCacheSize; }
+
     private:
+        class Prefetcher;
+        class MemoryMap;
+
+        /// @brief Read the next block of the dataset into the cache
+        /// @return False if there was nothing left to read
+        bool fillCache();
+
+        /// @brief Free the vlen data held in the cache
+        void reclaimCache();
+
+        /// @brief The memory holding a row of the cache
+        const void *cacheRow(std::size_t position);
+
+        /// A decoded block of the dataset held for random access
+        struct CachedBlock {
+            std::size_t index;
+            SmartBuffer buffer;
+            hsize_t nRows;
+        };
+
+        /// @brief Get a block for random access, reading it if it is not already held
+        const CachedBlock &cachedBlock(std::size_t index);
+
+        /// @brief Drop the least recently used block from the block cache
+        /// @return The buffer that held it, for reuse
+        SmartBuffer evictBlock();
+
         H5::DataType m_dtype;
+        /// The type of the data in the file, used to convert blocks without going through H5
+        H5::DataType m_fileDType;
+        /// The size of a single row in the cache
+        std::size_t m_objectSize;
         H5::DataSet m_dataset;
         SmartBuffer m_buffer;
         std::size_t m_cacheSize;
@@ -66,6 +335,24 @@ namespace H5Composites {
         std::size_t m_cachePosition{0};
         std::size_t m_nRemainingInDS{0};
         hsize_t m_nInCache{0};
+        /// The total number of rows in the dataset
+        std::size_t m_nRows{0};
+        /// The number of rows in each random access block, a multiple of the chunk size
+        std::size_t m_blockRows{0};
+        std::size_t m_blockCacheSize{8};
+        /// Blocks held for random access, most recently used first
+        std::list<CachedBlock> m_blocks;
+        std::map<std::size_t, std::list<CachedBlock>::iterator> m_blockIndex;
+        /// The secondary index, opened on first use
+        std::unique_ptr<DataSetIndex> m_index;
+        /// The mapping of the file, if rows are read from it directly
+        std::unique_ptr<MemoryMap> m_map;
+        std::unique_ptr<Prefetcher> m_prefetcher;
+        /// The arena holding the vlen data in the cache (if used)
+        std::unique_ptr<VLenArena> m_arena;
+        /// Held by pointer so that it is shared with the background thread
+        std::unique_ptr<IOMetricsRecorder> m_metrics;
+        IOMetricsCallback m_metricsCallback;
     };
 } // namespace H5Composites
 
@@ -1,11 +1,16 @@
 #ifndef H5COMPOSITES_SMARTBUFFER_HXX
 #define H5COMPOSITES_SMARTBUFFER_HXX
 
+#include "H5Composites/BufferAllocator.hxx"
+
 #include <cstddef>
 
 namespace H5Composites {
     /**
-     * @brief RAII behaviour for a memory buffer allocated with malloc and free
+     * @brief RAII behaviour for a memory buffer
+     *
+     * By default the memory is allocated with malloc and free, other BufferAllocators can be
+     * provided. All of them allocate memory that can be freed with std::free.
      */
     class SmartBuffer {
     public:
@@ -13,6 +18,8 @@ namespace H5Composites {
         SmartBuffer();
         /// Create a new slice of memory with the given size (in bytes)
         SmartBuffer(std::size_t size);
+        /// Create a new slice of memory with the given size (in bytes) from the given allocator
+        SmartBuffer(std::size_t size, const BufferAllocator &allocator);
         /// Create a new slice of memory with the given size (in bytes) and fill it with the
         /// specified value
         SmartBuffer(std::size_t size, unsigned char fill);
@@ -40,7 +47,7 @@ namespace H5Composites {
 
         explicit operator bool() const;
 
-        /// Set a new managed object
+        /// Set a new managed object, which must have been allocated by std::malloc
         void reset(void *buffer);
 
         /// Get access to the buffer
@@ -51,13 +58,19 @@ namespace H5Composites {
         void *get(std::size_t offset);
         /// Get (const) access to the buffer with an offset
         const void *get(std::size_t offset) const;
-        /// Release ownership of the buffer
+        /// Release ownership of the buffer. The memory can be freed with std::free
         void *release();
         /// Resize the owned memory
         bool resize(std::size_t size);
 
+        /// The allocator that owns the memory
+        const BufferAllocator &allocator() const { return *m_allocator; }
+
     private:
         void *m_buffer;
+        /// The requested size, 0 if ownership was taken of an existing pointer
+        std::size_t m_size{0};
+        const BufferAllocator *m_allocator;
     };
 } // namespace H5Composites
 
@@ -20,6 +20,13 @@ namespace H5Composites {
         TypedReader(const H5::DataSet &dataset, std::size_t cacheSize = -1)
                 : m_reader(getH5DType<T>(), dataset, cacheSize) {}
 
+        /// @brief Allocate the vlen data read into the cache from an arena
+        ///
+        /// See @ref Reader::useVLenArena
+        void useVLenArena(std::size_t blockSize = VLenArena::defaultBlockSize) {
+            m_reader.useVLenArena(blockSize);
+        }
+
         /// @brief The type read out into the cache
         const H5::DataType &dtype() const { return m_reader.dtype(); }
 
@@ -31,6 +38,75 @@ namespace H5Composites {
         /// Returns std::nullopt when the input dataset is exhausted
         std::optional<UnderlyingType_t<T>> next() { return m_reader.next<T>(); }
 
+        /// @brief Read up to n contiguous rows of the dataset
+        ///
+        /// See @ref Reader::nextBlock
+        H5BufferConstView nextBlock(std::size_t n) { return m_reader.nextBlock(n); }
+
+        /// @brief Read the next rows of the dataset into user memory
+        /// @return The number of objects read, less than the size of the span if the dataset is
+        ///         exhausted
+        std::size_t readInto(std::span<T> objs)
+            requires(!WrapperTrait<T>)
+        {
+            return m_reader.readInto(objs);
+        }
+
+        /// @brief The total number of rows in the dataset
+        std::size_t size() const { return m_reader.size(); }
+
+        /// @brief The row that the next call to next will return
+        std::size_t position() const { return m_reader.position(); }
+
+        /// @brief Move the read position, see @ref Reader::seek
+        void seek(std::size_t row) { m_reader.seek(row); }
+
+        /// @brief Read a single row by its index, see @ref Reader::read
+        UnderlyingType_t<T> read(std::size_t row) { return m_reader.read<T>(row); }
+
+        /// @brief Read a range of rows, see @ref Reader::readRange
+        std::vector<T> readRange(std::size_t first, std::size_t n)
+            requires(!WrapperTrait<T>)
+        {
+            return m_reader.readRange<T>(first, n);
+        }
+
+        /// @brief Find all rows with the given key, see @ref Reader::equalRange
+        template <typename... Ts>
+            requires(sizeof...(Ts) > 0 && IndexKey<Ts...> && (BufferWritable<Ts> && ...))
+        std::vector<std::size_t> equalRange(const Ts &...key) {
+            return m_reader.equalRange(key...);
+        }
+
+        /// @brief Find the first row with the given key, see @ref Reader::find
+        template <typename... Ts>
+            requires(sizeof...(Ts) > 0 && IndexKey<Ts...> && (BufferWritable<Ts> && ...))
+        std::optional<std::size_t> find(const Ts &...key) {
+            return m_reader.find(key...);
+        }
+
+        /// @brief Set the maximum number of blocks held for random access
+        void setBlockCacheSize(std::size_t nBlocks) { m_reader.setBlockCacheSize(nBlocks); }
+
+        /// @brief Read rows straight from a mapping of the file, see @ref Reader::useMemoryMap
+        bool useMemoryMap(Reader::AccessPattern pattern = Reader::AccessPattern::Sequential) {
+            return m_reader.useMemoryMap(pattern);
+        }
+
+        /// @brief Whether rows are read from a memory mapping
+        bool isMemoryMapped() const { return m_reader.isMemoryMapped(); }
+
+        /// @brief The work done by the reader so far
+        IOMetrics metrics() const { return m_reader.metrics(); }
+
+        /// @brief Set all metrics back to 0
+        void resetMetrics() { m_reader.resetMetrics(); }
+
+        /// @brief Set a function to be called with the current metrics after each refill
+        void setMetricsCallback(IOMetricsCallback callback) {
+            m_reader.setMetricsCallback(std::move(callback));
+        }
+
     private:
         Reader m_reader;
     };
@@ -27,21 +27,34 @@ namespace H5Composites {
          * @param targetGroup The group to write to
          * @param name The name of the dataset to create
          * @param cacheSize The number of objects to hold in memory before flushing to disk
-         * @param chunkSize The number of objects to store per dataset chunk (if -1 set to the
-         * cacheSize)
+         * @param chunkSize The number of objects to store per dataset chunk (if -1 chosen by the
+         * options if they request automatic chunking, otherwise set to the cacheSize)
+         * @param options Filters and chunking options for the dataset
          */
         TypedWriter(
                 const H5::Group &targetGroup, const std::string &name, std::size_t cacheSize = 2048,
-                std::size_t chunkSize = -1)
-                : Writer(targetGroup, name, getH5DType<T>(), cacheSize, chunkSize) {}
+                std::size_t chunkSize = -1, const DataSetCreationOptions &options = {})
+                : Writer(targetGroup, name, getH5DType<T>(), cacheSize, chunkSize, options) {}
 
         void write(const UnderlyingType_t<T> &obj) { Writer::write<T>(obj); }
 
         template <std::input_iterator Iterator>
             requires(std::convertible_to<std::iter_value_t<Iterator>, T>)
         void write(Iterator begin, Iterator end) {
-            for (Iterator itr = begin; itr != end; ++itr)
-                write(*itr);
+            if constexpr (
+                    std::contiguous_iterator<Iterator> &&
+                    std::same_as<std::iter_value_t<Iterator>, T> && !WrapperTrait<T>)
+                Writer::write(std::span(begin, end));
+            else
+                for (Iterator itr = begin; itr != end; ++itr)
+                    write(*itr);
+        }
+
+        /// Write a contiguous range of objects
+        void write(std::span<const T> objs)
+            requires(!WrapperTrait<T>)
+        {
+            Writer::write(objs);
         }
     };
 } // namespace H5Composites
@@ -0,0 +1,101 @@
+/**
+ * @file VLenArena.hxx
+ * @brief Bump allocator for variable length data
+ */
+
+#ifndef H5COMPOSITES_VLENARENA_HXX
+#define H5COMPOSITES_VLENARENA_HXX
+
+#include "H5Composites/SmartBuffer.hxx"
+
+#include "H5Cpp.h"
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace H5Composites {
+    /**
+     * @brief Bump allocator for the variable length data held in a cache block
+     *
+     * Memory is handed out from a small number of large blocks and is never returned
+     * individually. Instead the whole arena is reset at once, reusing the blocks for the next set
+     * of allocations. The arena can be installed as the H5 vlen memory manager through its
+     * transfer property list. The free function installed there ignores pointers belonging to the
+     * arena and passes anything else to std::free, so reclaiming a buffer that mixes both is safe.
+     */
+    class VLenArena {
+    public:
+        /// The default minimum size of each block
+        static constexpr std::size_t defaultBlockSize = 64 * 1024;
+
+        /// @brief Create the arena
+        /// @param blockSize The minimum size of each block allocated
+        explicit VLenArena(std::size_t blockSize = defaultBlockSize);
+
+        VLenArena(const VLenArena &) = delete;
+        VLenArena &operator=(const VLenArena &) = delete;
+
+        /// @brief Allocate memory from the arena
+        ///
+        /// The memory is aligned for any fundamental type and remains valid until the next reset
+        void *allocate(std::size_t size);
+
+        /// @brief Whether the pointer was allocated from this arena
+        bool owns(const void *ptr) const;
+
+        /// @brief Invalidate all allocations, making their memory available again
+        void reset();
+
+        /// @brief The minimum size of each block
+        std::size_t blockSize() const { return m_blockSize; }
+
+        /// @brief The total memory held by the arena
+        std::size_t capacity() const;
+
+        /// @brief Transfer property list that makes H5 allocate vlen data from this arena
+        const H5::DSetMemXferPropList &transferPropList() const { return m_transferPropList; }
+
+        /// @brief The arena used for vlen allocations on the current thread, nullptr if none
+        static VLenArena *current();
+
+        /// @brief The transfer property list for the current arena, the default if there is none
+        static const H5::PropList &currentTransferPropList();
+
+        /// @brief Set the current arena for the lifetime of this object
+        ///
+        /// Vlen data written by the buffer write traits and by convert while the arena is current
+        /// is allocated from it. H5Buffers created in this time also free their vlen data through
+        /// the arena so must not outlive it.
+        class Scope {
+        public:
+            /// @brief Make the arena current. A nullptr means that std::malloc is used
+            Scope(VLenArena *arena);
+            ~Scope();
+            Scope(const Scope &) = delete;
+            Scope &operator=(const Scope &) = delete;
+
+        private:
+            VLenArena *m_previous;
+        };
+
+    private:
+        static void *allocateCallback(std::size_t size, void *info);
+        static void freeCallback(void *ptr, void *info);
+
+        std::size_t m_blockSize;
+        /// The blocks and their sizes
+        std::vector<std::pair<SmartBuffer, std::size_t>> m_blocks;
+        std::size_t m_currentBlock{0};
+        /// The position in the current block
+        std::size_t m_position{0};
+        H5::DSetMemXferPropList m_transferPropList;
+    };
+
+    /// @brief Allocate memory for vlen data
+    ///
+    /// The memory comes from the current arena if there is one and otherwise from std::malloc
+    void *allocateVLen(std::size_t size);
+} // namespace H5Composites
+
+#endif //> !H5COMPOSITES_VLENARENA_HXX
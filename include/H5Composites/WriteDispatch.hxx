@@ -0,0 +1,118 @@
+/**
+ * @file WriteDispatch.hxx
+ * @brief The write overloads shared by the classes writing rows of a single data type
+ */
+
+#ifndef H5COMPOSITES_WRITEDISPATCH_HXX
+#define H5COMPOSITES_WRITEDISPATCH_HXX
+
+#include "H5Composites/BufferWriteTraits.hxx"
+#include "H5Composites/H5BufferConstView.hxx"
+#include "H5Composites/H5DType.hxx"
+#include "H5Composites/UnderlyingType.hxx"
+
+#include "H5Cpp.h"
+
+#include <iterator>
+#include <span>
+
+namespace H5Composites {
+    /**
+     * @brief Checks whether data types are identical to the one being written
+     *
+     * The last matching type is remembered so repeated calls with the same data type are cheap.
+     * Whether the type holds variable length data is worked out once, as copying such objects
+     * byte for byte would share their vlen memory with the caller.
+     */
+    class DirectWriteCheck {
+    public:
+        explicit DirectWriteCheck(const H5::DataType &dtype);
+
+        /// @brief Whether objects of the provided type can be copied without conversion
+        bool operator()(const H5::DataType &dtype);
+
+        /// @brief Whether objects of the provided type can be copied with memcpy
+        ///
+        /// Unlike the call operator this is false for types with variable length data
+        bool canCopyBytes(const H5::DataType &dtype) { return !m_hasVLenData && (*this)(dtype); }
+
+    private:
+        H5::DataType m_dtype;
+        bool m_hasVLenData;
+        /// A data type known to be identical to the stored one
+        H5::DataType m_directDType;
+    };
+
+    /**
+     * @brief Provides the typed write overloads in terms of a few functions of the writer
+     *
+     * Derived must provide
+     * - writeFromBuffer(const H5BufferConstView &buffer), writing a single object
+     * - writeFromBuffer(const H5BufferConstView &buffer, std::size_t n), writing a contiguous
+     *   array of objects
+     * - bool isDirectlyWritable(const H5::DataType &dtype)
+     * - writeDirect(const void *obj), copying an object whose layout exactly matches
+     *
+     * It may also provide writeToSlot<T>(const UnderlyingType_t<T> &obj) to write objects whose
+     * data type matches but which are not simply copied. Otherwise these go through a temporary
+     * buffer.
+     */
+    template <typename Derived> class WriteDispatch {
+    public:
+        /// Write an object
+        template <BufferWritable T>
+            requires WrapperTrait<T>
+        void write(const UnderlyingType_t<T> &obj) {
+            derived().writeFromBuffer(toBuffer<T>(obj));
+        }
+
+        /// Write an object
+        template <BufferWritable T>
+            requires(!WrapperTrait<T>)
+        void write(const T &obj) {
+            if constexpr (WithStaticH5DType<T>) {
+                // Skip the temporary buffer and conversion if the types match
+                if (derived().isDirectlyWritable(getH5DType<T>())) {
+                    if constexpr (BufferWriteIsCopy<T>)
+                        return derived().writeDirect(&obj);
+                    else if constexpr (requires { derived().template writeToSlot<T>(obj); })
+                        return derived().template writeToSlot<T>(obj);
+                }
+            }
+            derived().writeFromBuffer(toBuffer<T>(obj));
+        }
+
+        /// Write a contiguous range of objects
+        template <typename T, std::size_t Extent>
+            requires BufferWritable<std::remove_const_t<T>> &&
+                     (!WrapperTrait<std::remove_const_t<T>>)
+        void write(std::span<T, Extent> objs) {
+            using value_t = std::remove_const_t<T>;
+            if constexpr (BufferWriteIsCopy<value_t> && WithStaticH5DType<value_t>)
+                derived().writeFromBuffer(
+                        H5BufferConstView(objs.data(), getH5DType<value_t>()), objs.size());
+            else
+                for (const value_t &obj : objs)
+                    write<value_t>(obj);
+        }
+
+        /// Write a range of objects
+        template <
+                std::input_iterator Iterator,
+                BufferWritable T = typename std::iter_value_t<Iterator>>
+        void write(Iterator begin, Iterator end) {
+            if constexpr (
+                    std::contiguous_iterator<Iterator> &&
+                    std::same_as<T, std::iter_value_t<Iterator>> && !WrapperTrait<T>)
+                write(std::span(begin, end));
+            else
+                for (auto itr = begin; itr != end; ++itr)
+                    write<T>(*itr);
+        }
+
+    private:
+        Derived &derived() { return static_cast<Derived &>(*this); }
+    };
+} // namespace H5Composites
+
+#endif //> !H5COMPOSITES_WRITEDISPATCH_HXX
@@ -13,14 +13,22 @@
 #define H5COMPOSITES_WRITER_HXX
 
 #include "H5Composites/BufferWriteTraits.hxx"
+#include "H5Composites/DataSetCreationOptions.hxx"
 #include "H5Composites/H5BufferConstView.hxx"
+#include "H5Composites/H5BufferView.hxx"
+#include "H5Composites/IOMetrics.hxx"
 #include "H5Composites/SmartBuffer.hxx"
 #include "H5Composites/UnderlyingType.hxx"
+#include "H5Composites/VLenArena.hxx"
+#include "H5Composites/WriteDispatch.hxx"
 
 #include "H5Cpp.h"
 
+#include <memory>
+#include <span>
+
 namespace H5Composites {
-    class Writer {
+    class Writer : public WriteDispatch<Writer> {
     public:
         /**
          * @brief Construct a new Writer object
@@ -29,11 +37,15 @@ namespace H5Composites {
          * @param name The name of the dataset to create
          * @param dtype The data type to use
          * @param cacheSize The number of objects to hold in memory before flushing to disk
-         * @param chunkSize The number of objects to store per dataset chunk (if -1 set to the
-         * cacheSize)
+         * @param chunkSize The number of objects to store per dataset chunk (if -1 chosen by the
+         * options if they request automatic chunking, otherwise set to the cacheSize)
+         * @param options Filters and chunking options for the dataset
+         *
+         * The cache is allocated with BufferAllocator::cache()
          */
         Writer(const H5::Group &targetGroup, const std::string &name, const H5::DataType &dtype,
-               std::size_t cacheSize = 2048, std::size_t chunkSize = -1);
+               std::size_t cacheSize = 2048, std::size_t chunkSize = -1,
+               const DataSetCreationOptions &options = {});
 
         /// Move constructor
         Writer(Writer &&other);
@@ -48,8 +60,96 @@ namespace H5Composites {
         void clear();
 
         /// Flush all values held in the buffer to the file
+        ///
+        /// If the writer is flushing asynchronously then this only hands the buffer to the
+        /// background thread, use @ref sync to wait for the data to reach the file
         void flush();
 
+        /**
+         * @brief Write to the file from a background thread
+         * @param queueDepth The maximum number of full buffers waiting to be written
+         *
+         * When the cache fills it is swapped for an empty buffer and the full one is handed to a
+         * dedicated thread which extends the dataset, writes the data and reclaims any vlen
+         * memory. If queueDepth buffers are already waiting the writer blocks until one is free.
+         * Any error in the background thread is rethrown by the next call that flushes or by
+         * @ref sync. This requires the H5 library to have been built as thread-safe.
+         */
+        void startAsyncFlushing(std::size_t queueDepth = 2);
+
+        /// Whether the writer is flushing from a background thread
+        bool isFlushingAsync() const { return m_flusher != nullptr; }
+
+        /// @brief Wait until all data handed to the background thread has been written
+        ///
+        /// Rethrows any error from the background thread. Does nothing if the writer is not
+        /// flushing asynchronously.
+        void sync();
+
+#ifdef H5_HAVE_PARALLEL
+        /// The default limit on the number of rows a collective writer's cache can grow to
+        static constexpr std::size_t defaultMaxCollectiveCacheSize = 1 << 20;
+
+        /**
+         * @brief Write collectively with the other ranks of an MPI communicator
+         * @param comm The communicator, every rank of which must hold a writer for this dataset
+         * @param maxCacheSize The largest number of rows the cache may grow to between flushes
+         * @exception std::invalid_argument The file was not opened with the MPI-IO driver, or
+         *            maxCacheSize is smaller than the current cache size
+         * @exception std::logic_error Rows have already been written or the writer is flushing
+         *            asynchronously
+         *
+         * The file must have been opened on every rank with the MPI-IO driver, see
+         * GroupWrapper::createFile. Rather than flushing when full the cache then grows, and each
+         * call to @ref flush is collective: the ranks exchange the number of rows they hold,
+         * extend the dataset once and each rank writes its rows to its own part of the new space
+         * in a single collective transfer. Within a flush rows are ordered by rank. Every rank must
+         * make the same sequence of flushes (including the one made by the destructor) and of any
+         * other calls which modify the file, such as @ref setAttribute.
+         *
+         * The cache doubles each time it fills, up to maxCacheSize rows. The write that fills it at
+         * that size, and any after it, throw std::length_error rather than growing it further, so
+         * the ranks must flush together at least that often. Rows already in the cache, including
+         * the one that filled it, are kept and can still be flushed.
+         */
+        void useCollectiveIO(
+                MPI_Comm comm, std::size_t maxCacheSize = defaultMaxCollectiveCacheSize);
+
+        /// Whether flushes are collective across MPI ranks
+        bool isCollective() const { return m_comm != MPI_COMM_NULL; }
+#endif
+
+        /**
+         * @brief Allocate the vlen data held in each cache block from an arena
+         * @param blockSize The minimum size of the memory blocks in the arena
+         *
+         * Strings and vectors written to the cache are then carved out of a few large blocks and
+         * the whole arena is reset after each flush, rather than every element being allocated
+         * and freed separately. Anything currently in the cache is flushed first. This must be
+         * called before @ref startAsyncFlushing.
+         */
+        void useVLenArena(std::size_t blockSize = VLenArena::defaultBlockSize);
+
+        /// Whether vlen data in the cache is allocated from an arena
+        bool usesVLenArena() const { return m_arena != nullptr; }
+
+        /// @brief The work done by this writer so far
+        ///
+        /// When flushing asynchronously this only includes blocks the background thread has
+        /// finished with. Writes that bypass the cache count as a single block whose conversion is
+        /// done by H5 and so is included in the I/O time.
+        IOMetrics metrics() const { return m_metrics->snapshot(); }
+
+        /// Set all metrics back to 0
+        void resetMetrics() { m_metrics->reset(); }
+
+        /// @brief Set a function to be called with the current metrics after each flush
+        ///
+        /// The callback is always called from the thread that owns the writer
+        void setMetricsCallback(IOMetricsCallback callback) {
+            m_metricsCallback = std::move(callback);
+        }
+
         /// The stored datatype
         const H5::DataType &dtype() const { return m_dtype; }
 
@@ -60,6 +160,8 @@ namespace H5Composites {
         const H5::DataSet &dataset() const { return m_dataset; }
 
         /// The current offset (the number of events already saved to file)
+        ///
+        /// When flushing asynchronously this includes events queued to be written
         hsize_t offset() const { return m_offset; }
 
         /// The number of objects currently in the buffer
@@ -73,21 +175,31 @@ namespace H5Composites {
          */
         void writeFromBuffer(const H5BufferConstView &buffer);
 
-        /// Write an object to the buffer
-        template <BufferWritable T>
-            requires WrapperTrait<T>
-        void write(const UnderlyingType_t<T> &obj);
+        /**
+         * @brief Write a contiguous array of objects held in a buffer
+         * @param buffer View on the first object
+         * @param n The number of objects
+         *
+         * As many objects as fit in the cache are converted at once. If there are more objects
+         * than fit in the cache then, unless the conversion can be done by a MemberwiseConverter,
+         * the cache is flushed and the whole array is written directly to the dataset in a
+         * single call, leaving H5 to perform any conversion.
+         */
+        void writeFromBuffer(const H5BufferConstView &buffer, std::size_t n);
 
-        /// Write an object to the buffer
-        template <BufferWritable T>
-            requires(!WrapperTrait<T>)
-        void write(const T &obj);
+        /**
+         * @brief Copy an object directly into the buffer
+         * @param obj Pointer to the object, the memory layout must exactly match dtype()
+         *
+         * No checking or conversion of any kind is done.
+         */
+        void writeDirect(const void *obj);
 
-        /// Write a range of objects to the buffer
-        template <
-                std::input_iterator Iterator,
-                BufferWritable T = typename std::iter_value_t<Iterator>>
-        void write(Iterator begin, Iterator end);
+        /// @brief Whether objects of the provided type can be copied directly into the buffer
+        ///
+        /// The result of the comparison is remembered so repeated calls with the same data type
+        /// are cheap
+        bool isDirectlyWritable(const H5::DataType &dtype) { return m_directCheck(dtype); }
 
         /// Set a single column to be the index
         void setIndex(const std::string &index);
@@ -95,16 +207,56 @@ namespace H5Composites {
         /// Set multiple columns to be the index
         void setIndex(const std::vector<std::string> &index);
 
+        /// @brief Write a sorted index over the columns set by @ref setIndex
+        ///
+        /// Everything written so far is flushed to the file first. The index only covers the rows
+        /// already written, so this should be called once writing is finished. See DataSetIndex.
+        void buildIndex();
+
         /// @brief Set a named attribute on the output dataset
         /// @param name The attribute name
         /// @param value The value to set
         void setAttribute(const std::string &name, const H5BufferConstView &value);
 
     private:
+        friend class WriteDispatch<Writer>;
+        class Flusher;
+
+        /// @brief Write an object of the stored type which is not simply copied into the buffer
+        template <BufferWritable T> void writeToSlot(const UnderlyingType_t<T> &obj);
+
+        /// @brief Append objects to the end of the dataset
+        /// @param buffer Memory holding the objects
+        /// @param dtype The type of the objects in memory
+        /// @param n The number of objects
+        void writeToDataSet(const void *buffer, const H5::DataType &dtype, std::size_t n);
+
+        /// @brief The next free slot in the cache
+        H5BufferView nextSlot();
+
+        /// @brief Mark the next free slot as filled, flushing if the cache is full
+        void commitSlot();
+
+        /// @brief Make space in a full cache, by flushing it or by growing it if collective
+        /// @exception std::length_error A collective cache is already at its maximum size
+        void cacheFull();
+
+        /// @brief Whether flushes have to be made together with other MPI ranks
+        bool collective() const;
+
+#ifdef H5_HAVE_PARALLEL
+        /// @brief Write the cache of every rank to the dataset
+        void collectiveFlush();
+#endif
+
         /// The data type
         H5::DataType m_dtype;
         /// The cache size
         std::size_t m_cacheSize;
+        /// The size of a single object
+        std::size_t m_objectSize;
+        /// Whether data types match the stored one
+        DirectWriteCheck m_directCheck;
         /// The output dataset
         H5::DataSet m_dataset;
         /// The current offset
@@ -113,6 +265,20 @@ namespace H5Composites {
         std::size_t m_nInBuffer{0};
         /// The buffer
         SmartBuffer m_buffer;
+        /// Held by pointer so that the background thread can keep using it if the writer moves.
+        /// Declared before the flusher so that it outlives the background thread
+        std::unique_ptr<IOMetricsRecorder> m_metrics;
+        IOMetricsCallback m_metricsCallback;
+        /// The background thread used for asynchronous flushing
+        std::unique_ptr<Flusher> m_flusher;
+        /// The arena holding the vlen data in the buffer (if used)
+        std::unique_ptr<VLenArena> m_arena;
+#ifdef H5_HAVE_PARALLEL
+        /// The communicator for collective writes, MPI_COMM_NULL if writing independently
+        MPI_Comm m_comm{MPI_COMM_NULL};
+        /// The largest the cache may grow to when writing collectively
+        std::size_t m_maxCacheSize{0};
+#endif
     };
 } // namespace H5Composites
 
@@ -1,22 +1,10 @@
 namespace H5Composites {
-    /// Write an object to the buffer
-    template <BufferWritable T>
-        requires WrapperTrait<T>
-    void Writer::write(const UnderlyingType_t<T> &obj) {
-        writeFromBuffer(toBuffer<T>(obj));
+    template <BufferWritable T> void Writer::writeToSlot(const UnderlyingType_t<T> &obj) {
+        {
+            // Any vlen data goes straight into the cache's arena
+            VLenArena::Scope scope(m_arena.get());
+            BufferWriteTraits<T>::write(obj, nextSlot());
+        }
+        commitSlot();
     }
-
-    /// Write an object to the buffer
-    template <BufferWritable T>
-        requires(!WrapperTrait<T>)
-    void Writer::write(const T &obj) {
-        writeFromBuffer(toBuffer<T>(obj));
-    }
-
-    /// Write a range of objects to the buffer
-    template <std::input_iterator Iterator, BufferWritable T>
-    void Writer::write(Iterator begin, Iterator end) {
-        for (auto itr = begin; itr != end; ++itr)
-            write<T>(*itr);
-    }
-} // namespace H5Composites
\ No newline at end of file
+} // namespace H5Composites
@@ -8,6 +8,7 @@
 #include "H5Composites/DTypePrinting.hxx"
 #include "H5Composites/H5DType.hxx"
 #include "H5Composites/UnderlyingType.hxx"
+#include "H5Composites/VLenArena.hxx"
 
 #include <vector>
 
@@ -66,12 +67,13 @@ namespace H5Composites {
                         toString(buffer.dtype()) + " is not a vlen data type");
             hvl_t *vldata = buffer.as<hvl_t>();
             vldata->len = value.size();
-            SmartBuffer dataBuffer = SmartBuffer::copy(value.data(), sizeof(T) * value.size());
             H5::DataType sourceDType = getH5DType(value);
-            vldata->p = dataBuffer.get();
-            if (sourceDType == buffer.dtype())
-                dataBuffer.release();
-            else {
+            if (sourceDType == buffer.dtype()) {
+                vldata->p = allocateVLen(sizeof(T) * value.size());
+                std::memcpy(vldata->p, value.data(), sizeof(T) * value.size());
+            } else {
+                SmartBuffer dataBuffer = SmartBuffer::copy(value.data(), sizeof(T) * value.size());
+                vldata->p = dataBuffer.get();
                 H5Buffer converted = convert({buffer.get(), sourceDType}, buffer.dtype());
                 vldata->p = converted.as<hvl_t>()->p;
                 converted.transferVLenOwnership().release();
@@ -84,9 +86,10 @@ namespace H5Composites {
     struct BufferWriteTraits<std::vector<T, Allocator>> {
         static void write(const std::vector<UnderlyingType_t<T>> &value, H5BufferView buffer) {
             hvl_t *vldata = buffer.as<hvl_t>();
-            SmartBuffer tmp(buffer.dtype().getSuper().getSize() * value.size());
             vldata->len = value.size();
-            vldata->p = tmp.get();
+            vldata->p = allocateVLen(buffer.dtype().getSuper().getSize() * value.size());
+            // Free the memory if an element fails to write. Arena memory does not need this
+            SmartBuffer tmp(VLenArena::current() ? nullptr : vldata->p);
             auto vecItr = value.begin();
             for (H5BufferView element : buffer)
                 BufferWriteTraits<T>::write(*vecItr++, element);
@@ -0,0 +1,139 @@
+#include "H5Composites/BufferAllocator.hxx"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdlib>
+#include <vector>
+
+#if __has_include(<sys/mman.h>)
+#include <sys/mman.h>
+#endif
+
+namespace {
+    using H5Composites::BufferAllocator;
+
+    std::size_t roundUp(std::size_t size, std::size_t multiple) {
+        return (std::max<std::size_t>(size, 1) + multiple - 1) / multiple * multiple;
+    }
+
+    class StandardAllocator : public BufferAllocator {
+    public:
+        void *allocate(std::size_t size) const override { return std::malloc(size); }
+    };
+
+    class AlignedAllocator : public BufferAllocator {
+    public:
+        void *allocate(std::size_t size) const override {
+            return std::aligned_alloc(alignment, roundUp(size, alignment));
+        }
+    };
+
+    class HugePageAllocator : public AlignedAllocator {
+    public:
+        void *allocate(std::size_t size) const override {
+            if (size < hugePageSize)
+                return AlignedAllocator::allocate(size);
+            size = roundUp(size, hugePageSize);
+            void *ptr = std::aligned_alloc(hugePageSize, size);
+#ifdef MADV_HUGEPAGE
+            // This is only advice so failure (e.g. huge pages being disabled) is not an error
+            if (ptr)
+                madvise(ptr, size, MADV_HUGEPAGE);
+#endif
+            return ptr;
+        }
+    };
+
+    class PooledAllocator : public BufferAllocator {
+    public:
+        void *allocate(std::size_t size) const override {
+            std::size_t idx = sizeClass(size);
+            if (idx == nClasses)
+                return std::malloc(size);
+            std::vector<void *> &freeList = pool().freeLists[idx];
+            if (freeList.empty())
+                return std::malloc(classSize(idx));
+            void *ptr = freeList.back();
+            freeList.pop_back();
+            return ptr;
+        }
+
+        void deallocate(void *ptr, std::size_t size) const override {
+            std::size_t idx = sizeClass(size);
+            if (idx == nClasses)
+                return std::free(ptr);
+            std::vector<void *> &freeList = pool().freeLists[idx];
+            if (freeList.size() < maxPerClass)
+                freeList.push_back(ptr);
+            else
+                std::free(ptr);
+        }
+
+    private:
+        /// Size classes go from 16 bytes to 4kB
+        static constexpr std::size_t minShift = 4;
+        static constexpr std::size_t nClasses = 9;
+        /// The maximum number of free allocations cached per class and thread
+        static constexpr std::size_t maxPerClass = 64;
+
+        struct Pool {
+            std::array<std::vector<void *>, nClasses> freeLists;
+            ~Pool() {
+                for (std::vector<void *> &freeList : freeLists)
+                    for (void *ptr : freeList)
+                        std::free(ptr);
+            }
+        };
+
+        static Pool &pool() {
+            thread_local Pool pool;
+            return pool;
+        }
+
+        /// The index of the smallest class holding size, nClasses if it is too large
+        static std::size_t sizeClass(std::size_t size) {
+            if (size <= (std::size_t{1} << minShift))
+                return 0;
+            return std::min<std::size_t>(std::bit_width(size - 1) - minShift, nClasses);
+        }
+
+        static std::size_t classSize(std::size_t idx) { return std::size_t{1} << (idx + minShift); }
+    };
+
+    std::atomic<const BufferAllocator *> &cacheAllocator() {
+        static std::atomic<const BufferAllocator *> allocator{&BufferAllocator::aligned()};
+        return allocator;
+    }
+} // namespace
+
+namespace H5Composites {
+    void BufferAllocator::deallocate(void *ptr, std::size_t) const { std::free(ptr); }
+
+    const BufferAllocator &BufferAllocator::standard() {
+        static const StandardAllocator allocator;
+        return allocator;
+    }
+
+    const BufferAllocator &BufferAllocator::aligned() {
+        static const AlignedAllocator allocator;
+        return allocator;
+    }
+
+    const BufferAllocator &BufferAllocator::hugePage() {
+        static const HugePageAllocator allocator;
+        return allocator;
+    }
+
+    const BufferAllocator &BufferAllocator::pooled() {
+        static const PooledAllocator allocator;
+        return allocator;
+    }
+
+    const BufferAllocator &BufferAllocator::cache() { return *cacheAllocator().load(); }
+
+    void BufferAllocator::setCache(const BufferAllocator &allocator) {
+        cacheAllocator().store(&allocator);
+    }
+} // namespace H5Composites
@@ -0,0 +1,95 @@
+#include "H5Composites/ColumnarReader.hxx"
+#include "H5Composites/ColumnarWriter.hxx"
+#include "H5Composites/CompDTypeUtils.hxx"
+#include "H5Composites/DTypeIterator.hxx"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace H5Composites {
+    ColumnarReader::ColumnarReader(const H5::Group &group, std::size_t cacheSize)
+            : ColumnarReader(
+                      group, group.openCompType(ColumnarWriter::rowTypeName), cacheSize) {}
+
+    ColumnarReader::ColumnarReader(
+            const H5::Group &group, const std::vector<std::string> &members,
+            std::size_t cacheSize)
+            : ColumnarReader(
+                      group,
+                      projectCompoundDType(
+                              group.openCompType(ColumnarWriter::rowTypeName), members),
+                      cacheSize) {}
+
+    ColumnarReader::ColumnarReader(
+            const H5::Group &group, const H5::DataType &dtype, std::size_t cacheSize)
+            : m_group(group), m_dtype(dtype), m_objectSize(dtype.getSize()) {
+        std::size_t maxSize = 0;
+        for (DTypeIterator itr(m_dtype); itr.elemType() != DTypeIterator::ElemType::End; ++itr) {
+            if (itr.elemType() == DTypeIterator::ElemType::Compound ||
+                itr.elemType() == DTypeIterator::ElemType::CompoundClose)
+                continue;
+            m_names.push_back(itr.fullName());
+            // The column readers never use their caches so keep them as small as possible
+            m_columns.push_back(Column{
+                    itr.offset(),
+                    std::make_unique<Reader>(*itr, m_group.openDataSet(m_names.back()), 1)});
+            maxSize = std::max(maxSize, itr->getSize());
+        }
+        if (m_columns.empty())
+            throw std::invalid_argument("No columns selected");
+        const H5::DataSet &first = m_columns.front().reader->dataset();
+        if (cacheSize == static_cast<std::size_t>(-1)) {
+            hsize_t chunkSize;
+            first.getCreatePlist().getChunk(1, &chunkSize);
+            cacheSize = chunkSize;
+        }
+        m_cacheSize = cacheSize;
+        m_nRemaining = m_columns.front().reader->nRemaining();
+        m_buffer = SmartBuffer(m_cacheSize * m_objectSize, BufferAllocator::cache());
+        m_values = SmartBuffer(m_cacheSize * maxSize, BufferAllocator::cache());
+    }
+
+    Reader ColumnarReader::columnReader(const std::string &name, std::size_t cacheSize) const {
+        return Reader(m_group.openDataSet(name), cacheSize);
+    }
+
+    H5BufferConstView ColumnarReader::next() {
+        if (m_cachePosition >= m_nInCache && !fillCache())
+            return {};
+        std::size_t cacheOffset = m_cachePosition * m_objectSize;
+        ++m_cachePosition;
+        return H5BufferConstView(m_buffer.get(cacheOffset), m_dtype);
+    }
+
+    H5BufferConstView ColumnarReader::nextBlock(std::size_t n) {
+        if (n == 0 || (m_cachePosition >= m_nInCache && !fillCache()))
+            return {};
+        hsize_t nRows = std::min(n, m_nInCache - m_cachePosition);
+        std::size_t cacheOffset = m_cachePosition * m_objectSize;
+        m_cachePosition += nRows;
+        return H5BufferConstView(m_buffer.get(cacheOffset), H5::ArrayType(m_dtype, 1, &nRows));
+    }
+
+    bool ColumnarReader::fillCache() {
+        if (m_nRemaining == 0)
+            return false;
+        std::size_t nRows = std::min(m_cacheSize, m_nRemaining);
+        std::byte *rows = static_cast<std::byte *>(m_buffer.get());
+        std::byte *values = static_cast<std::byte *>(m_values.get());
+        for (std::size_t idx = 0; idx < m_columns.size(); ++idx) {
+            Reader &reader = *m_columns[idx].reader;
+            std::size_t size = reader.dtype().getSize();
+            if (reader.readInto(H5BufferView(values, reader.dtype()), nRows) != nRows)
+                throw std::runtime_error("Column " + m_names[idx] + " is shorter than the others");
+            // Scatter the values into the rows
+            for (std::size_t row = 0; row < nRows; ++row)
+                std::memcpy(rows + row * m_objectSize + m_columns[idx].offset, values + row * size,
+                            size);
+        }
+        m_nRemaining -= nRows;
+        m_cachePosition = 0;
+        m_nInCache = nRows;
+        return true;
+    }
+} // namespace H5Composites
@@ -0,0 +1,127 @@
+#include "H5Composites/ColumnarWriter.hxx"
+#include "H5Composites/DTypeConversion.hxx"
+#include "H5Composites/DTypeIterator.hxx"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+    /// @brief Check that the type can be written in the columnar layout, then create the group
+    ///
+    /// Everything is checked before anything is created in the file
+    H5::Group createColumnGroup(
+            const H5::Group &targetGroup, const std::string &name, const H5::DataType &dtype) {
+        using H5Composites::DTypeIterator;
+        if (dtype.getClass() != H5T_COMPOUND)
+            throw std::invalid_argument("The columnar layout requires a compound data type");
+        if (targetGroup.nameExists(name))
+            throw std::invalid_argument(name + " already exists in H5 group");
+        for (DTypeIterator itr(dtype); itr.elemType() != DTypeIterator::ElemType::End; ++itr) {
+            DTypeIterator::ElemType elemType = itr.elemType();
+            if (elemType == DTypeIterator::ElemType::Compound ||
+                elemType == DTypeIterator::ElemType::CompoundClose)
+                continue;
+            if (H5Tdetect_class(itr->getId(), H5T_VLEN) > 0 ||
+                (elemType == DTypeIterator::ElemType::String && itr->isVariableStr()))
+                throw std::invalid_argument(
+                        "Variable length member " + itr.fullName() +
+                        " cannot be written in the columnar layout");
+        }
+        return targetGroup.createGroup(name);
+    }
+} // namespace
+
+namespace H5Composites {
+    ColumnarWriter::ColumnarWriter(
+            const H5::Group &targetGroup, const std::string &name, const H5::DataType &dtype,
+            std::size_t cacheSize, std::size_t chunkSize, const DataSetCreationOptions &options)
+            : m_dtype(dtype), m_directCheck(dtype), m_cacheSize(cacheSize),
+              m_group(createColumnGroup(targetGroup, name, dtype)) {
+        std::vector<std::pair<std::size_t, H5::DataType>> leaves;
+        std::size_t maxSize = 0;
+        for (DTypeIterator itr(dtype); itr.elemType() != DTypeIterator::ElemType::End; ++itr) {
+            DTypeIterator::ElemType elemType = itr.elemType();
+            if (elemType == DTypeIterator::ElemType::Compound ||
+                elemType == DTypeIterator::ElemType::CompoundClose)
+                continue;
+            m_names.push_back(itr.fullName());
+            leaves.emplace_back(itr.offset(), *itr);
+            maxSize = std::max(maxSize, itr->getSize());
+        }
+        H5::DataType rowType;
+        rowType.copy(m_dtype);
+        rowType.commit(m_group, rowTypeName);
+        m_columns.reserve(leaves.size());
+        for (std::size_t idx = 0; idx < leaves.size(); ++idx)
+            m_columns.push_back(Column{
+                    leaves[idx].first,
+                    std::make_unique<Writer>(
+                            m_group, m_names[idx], leaves[idx].second, cacheSize, chunkSize,
+                            options)});
+        m_values = SmartBuffer(cacheSize * maxSize, BufferAllocator::cache());
+    }
+
+    hsize_t ColumnarWriter::nRows() const {
+        if (m_columns.empty())
+            return 0;
+        const Writer &writer = *m_columns.front().writer;
+        return writer.offset() + writer.nInBuffer();
+    }
+
+    void ColumnarWriter::flush() {
+        for (Column &column : m_columns)
+            column.writer->flush();
+    }
+
+    void ColumnarWriter::startAsyncFlushing(std::size_t queueDepth) {
+        for (Column &column : m_columns)
+            column.writer->startAsyncFlushing(queueDepth);
+    }
+
+    void ColumnarWriter::sync() {
+        for (Column &column : m_columns)
+            column.writer->sync();
+    }
+
+    void ColumnarWriter::writeFromBuffer(const H5BufferConstView &buffer) {
+        writeFromBuffer(buffer, 1);
+    }
+
+    void ColumnarWriter::writeFromBuffer(const H5BufferConstView &buffer, std::size_t n) {
+        const std::byte *source = static_cast<const std::byte *>(buffer.get());
+        if (isDirectlyWritable(buffer.dtype()))
+            return writeRows(source, n);
+        std::size_t rowSize = m_dtype.getSize();
+        if (!m_rows)
+            m_rows = SmartBuffer(m_cacheSize * rowSize, BufferAllocator::cache());
+        for (std::size_t idx = 0; idx < n; idx += m_cacheSize) {
+            std::size_t nRows = std::min(n - idx, m_cacheSize);
+            convert(H5BufferConstView(source + idx * buffer.footprint(), buffer.dtype()),
+                    H5BufferView(m_rows.get(), m_dtype), nRows);
+            writeRows(static_cast<const std::byte *>(m_rows.get()), nRows);
+        }
+    }
+
+    void ColumnarWriter::setAttribute(const std::string &name, const H5BufferConstView &value) {
+        m_group.createAttribute(name, value.dtype(), H5S_SCALAR).write(value.dtype(), value.get());
+    }
+
+    void ColumnarWriter::writeRows(const std::byte *rows, std::size_t n) {
+        std::size_t rowSize = m_dtype.getSize();
+        std::byte *values = static_cast<std::byte *>(m_values.get());
+        for (std::size_t first = 0; first < n; first += m_cacheSize) {
+            std::size_t nRows = std::min(n - first, m_cacheSize);
+            const std::byte *block = rows + first * rowSize;
+            for (Column &column : m_columns) {
+                // Gather the member from each row so the column can be copied in one go
+                std::size_t size = column.writer->dtype().getSize();
+                for (std::size_t idx = 0; idx < nRows; ++idx)
+                    std::memcpy(
+                            values + idx * size, block + idx * rowSize + column.offset, size);
+                column.writer->writeFromBuffer(
+                        H5BufferConstView(values, column.writer->dtype()), nRows);
+            }
+        }
+    }
+} // namespace H5Composites
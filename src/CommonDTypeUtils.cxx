@@ -85,8 +85,7 @@ namespace {
     auto all_equal(Range &&r, Proj proj = {}) {
         auto start = std::ranges::begin(r);
         auto first = proj(*start);
-        auto itr = start + 1;
-        while (itr != std::ranges::end(r))
+        for (auto itr = start + 1; itr != std::ranges::end(r); ++itr)
             if (first != proj(*itr))
                 return false;
         return true;
@@ -1,5 +1,8 @@
 #include "H5Composites/CompDTypeUtils.hxx"
 
+#include <map>
+#include <stdexcept>
+
 namespace H5Composites {
     std::vector<std::string> getCompoundElementNames(const H5::CompType &dtype) {
         auto names = std::ranges::views::iota(0, dtype.getNmembers()) |
@@ -25,6 +28,47 @@ namespace H5Composites {
         return dtype;
     }
 
+    H5::CompType projectCompoundDType(
+            const H5::CompType &dtype, const std::vector<std::string> &paths,
+            const std::string &sep) {
+        // Group the requested paths by their top-level member. An empty list of sub-paths means
+        // that the whole member is kept
+        std::map<std::string, std::vector<std::string>> subPaths;
+        std::map<std::string, bool> keepWhole;
+        for (const std::string &path : paths) {
+            std::size_t pos = path.find(sep);
+            std::string head = path.substr(0, pos);
+            if (pos == std::string::npos)
+                keepWhole[head] = true;
+            else {
+                keepWhole.try_emplace(head, false);
+                subPaths[head].push_back(path.substr(pos + sep.size()));
+            }
+        }
+        std::vector<std::pair<H5::DataType, std::string>> components;
+        for (int idx = 0; idx < dtype.getNmembers(); ++idx) {
+            std::string name = dtype.getMemberName(idx);
+            auto itr = keepWhole.find(name);
+            if (itr == keepWhole.end())
+                continue;
+            H5::DataType memberDType = dtype.getMemberDataType(idx);
+            if (itr->second)
+                components.emplace_back(memberDType, name);
+            else if (memberDType.getClass() == H5T_COMPOUND)
+                components.emplace_back(
+                        projectCompoundDType(
+                                H5::CompType(memberDType.getId()), subPaths[name], sep),
+                        name);
+            else
+                throw std::invalid_argument("Member '" + name + "' is not a compound type");
+            keepWhole.erase(itr);
+        }
+        if (!keepWhole.empty())
+            throw std::invalid_argument(
+                    "No member '" + keepWhole.begin()->first + "' in compound data type");
+        return createCompoundDType(components);
+    }
+
     void *getMemberPointer(void *buffer, const H5::CompType &dtype, std::size_t idx) {
         return static_cast<std::byte *>(buffer) + dtype.getMemberOffset(idx);
     }
@@ -0,0 +1,348 @@
+#include "H5Composites/ConcurrentWriter.hxx"
+#include "H5Composites/DTypeConversion.hxx"
+#include "H5Composites/Writer.hxx"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+namespace H5Composites {
+    /// @brief Appends the blocks handed over by the producers to the dataset in a single thread
+    ///
+    /// Every batch of blocks is stored against a sequence number, in arrival order these are just
+    /// assigned as the batches come in. The thread always writes the batch with the next sequence
+    /// number once it is available. Empty buffers are kept to be handed out again.
+    class ConcurrentWriter::Committer {
+    public:
+        Committer(
+                const H5::Group &targetGroup, const std::string &name, const H5::DataType &dtype,
+                std::size_t blockSize, std::size_t chunkSize, const DataSetCreationOptions &options,
+                CommitOrder order, std::size_t maxQueued)
+                // With no cache every write goes straight to the dataset
+                : m_writer(targetGroup, name, dtype, 0, chunkSize, options), m_dtype(dtype),
+                  m_blockBytes(blockSize * dtype.getSize()), m_order(order),
+                  m_maxQueued(maxQueued) {
+            m_thread = std::thread(&Committer::run, this);
+        }
+
+        ~Committer() {
+            {
+                std::lock_guard lock(m_mutex);
+                m_stop = true;
+            }
+            m_cv.notify_all();
+            m_thread.join();
+            // Anything left over was either waiting on a sequence number that never arrived or
+            // is here because of an error
+            std::size_t nLost = 0;
+            for (auto &[sequence, blocks] : m_ready)
+                for (Block &block : blocks) {
+                    nLost += block.nRows;
+                    reclaim(block);
+                }
+            if (nLost && !m_error)
+                std::cerr << "Failed to write " << nLost << " rows to "
+                          << m_writer.dataset().getObjName() << ": sequence number " << m_next
+                          << " was never committed" << std::endl;
+        }
+
+        CommitOrder order() const { return m_order; }
+
+        const Writer &writer() const { return m_writer; }
+
+        hsize_t nWritten() const { return m_nWritten; }
+
+        /// @brief Get an empty buffer
+        SmartBuffer acquire() {
+            {
+                std::lock_guard lock(m_mutex);
+                if (!m_free.empty()) {
+                    SmartBuffer buffer = std::move(m_free.back());
+                    m_free.pop_back();
+                    return buffer;
+                }
+            }
+            return SmartBuffer(m_blockBytes, BufferAllocator::cache());
+        }
+
+        /// @brief Return a buffer that holds no vlen data
+        void release(SmartBuffer &&buffer) {
+            std::lock_guard lock(m_mutex);
+            m_free.push_back(std::move(buffer));
+        }
+
+        /// @brief Free the vlen data held in a block
+        void reclaim(Block &block) {
+            hsize_t nRows = block.nRows;
+            if (nRows)
+                H5Dvlen_reclaim(
+                        m_dtype.getId(), H5::DataSpace(1, &nRows).getId(), H5P_DEFAULT,
+                        block.buffer.get());
+            block.nRows = 0;
+        }
+
+        /// @brief Hand over a batch of blocks to be written
+        /// @param blocks The blocks, which will be written in order
+        /// @param sequence The sequence number, or std::nullopt in arrival order
+        void submit(std::vector<Block> &&blocks, std::optional<std::uint64_t> sequence) {
+            std::unique_lock lock(m_mutex);
+            if (!sequence) {
+                m_cv.wait(lock, [this] { return m_ready.size() < m_maxQueued || m_error; });
+                sequence = m_nextArrival++;
+            } else if (*sequence < m_next || m_ready.count(*sequence)) {
+                lock.unlock();
+                for (Block &block : blocks)
+                    reclaim(block);
+                throw std::invalid_argument(
+                        "Sequence number " + std::to_string(*sequence) + " already committed");
+            }
+            if (m_error) {
+                std::exception_ptr error = m_error;
+                lock.unlock();
+                // These blocks will never be written so free their vlen data
+                for (Block &block : blocks)
+                    reclaim(block);
+                std::rethrow_exception(error);
+            }
+            m_ready.emplace(*sequence, std::move(blocks));
+            lock.unlock();
+            m_cv.notify_all();
+        }
+
+        /// @brief Wait until no more batches can be written
+        void sync() {
+            std::unique_lock lock(m_mutex);
+            m_cv.wait(lock, [this] { return (!hasNext() && !m_busy) || m_error; });
+            if (m_error)
+                std::rethrow_exception(m_error);
+        }
+
+    private:
+        /// Whether the batch with the next sequence number is available. Requires the lock
+        bool hasNext() const { return !m_ready.empty() && m_ready.begin()->first == m_next; }
+
+        void run() {
+            std::unique_lock lock(m_mutex);
+            while (true) {
+                m_cv.wait(lock, [this] { return m_stop || hasNext(); });
+                if (!hasNext())
+                    // Only stop once everything that can be written has been
+                    return;
+                std::vector<Block> blocks = std::move(m_ready.begin()->second);
+                m_ready.erase(m_ready.begin());
+                ++m_next;
+                m_busy = true;
+                lock.unlock();
+                try {
+                    for (Block &block : blocks) {
+                        if (block.nRows == 0)
+                            continue;
+                        m_writer.writeFromBuffer(
+                                H5BufferConstView(block.buffer.get(), m_dtype), block.nRows);
+                        m_nWritten += block.nRows;
+                        reclaim(block);
+                    }
+                } catch (...) {
+                    for (Block &block : blocks)
+                        reclaim(block);
+                    lock.lock();
+                    m_error = std::current_exception();
+                    m_busy = false;
+                    m_cv.notify_all();
+                    return;
+                }
+                lock.lock();
+                for (Block &block : blocks)
+                    m_free.push_back(std::move(block.buffer));
+                m_busy = false;
+                m_cv.notify_all();
+            }
+        }
+
+        Writer m_writer;
+        H5::DataType m_dtype;
+        std::size_t m_blockBytes;
+        CommitOrder m_order;
+        std::size_t m_maxQueued;
+        std::mutex m_mutex;
+        std::condition_variable m_cv;
+        std::map<std::uint64_t, std::vector<Block>> m_ready;
+        std::vector<SmartBuffer> m_free;
+        /// The next sequence number to write
+        std::uint64_t m_next{0};
+        /// The next sequence number to assign in arrival order
+        std::uint64_t m_nextArrival{0};
+        std::atomic<hsize_t> m_nWritten{0};
+        bool m_stop{false};
+        bool m_busy{false};
+        std::exception_ptr m_error;
+        std::thread m_thread;
+    };
+
+    ConcurrentWriter::Producer::Producer(
+            Committer &committer, const H5::DataType &dtype, std::size_t blockSize)
+            : m_committer(&committer), m_dtype(dtype), m_directCheck(dtype),
+              m_blockSize(blockSize), m_objectSize(dtype.getSize()),
+              m_block{committer.acquire(), 0} {}
+
+    ConcurrentWriter::Producer::Producer(Producer &&other)
+            : m_committer(other.m_committer), m_dtype(other.m_dtype),
+              m_directCheck(other.m_directCheck), m_blockSize(other.m_blockSize),
+              m_objectSize(other.m_objectSize), m_block(std::move(other.m_block)),
+              m_full(std::move(other.m_full)) {
+        other.m_committer = nullptr;
+    }
+
+    ConcurrentWriter::Producer::~Producer() {
+        if (!m_committer)
+            return;
+        if (m_committer->order() == CommitOrder::Arrival) {
+            // Cannot throw from a destructor so this is the last chance to report any error
+            try {
+                flush();
+            } catch (const H5::Exception &e) {
+                std::cerr << "Failed to hand over rows: " << e.getDetailMsg() << std::endl;
+            } catch (const std::exception &e) {
+                std::cerr << "Failed to hand over rows: " << e.what() << std::endl;
+            } catch (...) {
+                std::cerr << "Failed to hand over rows: unknown error" << std::endl;
+            }
+        }
+        discard();
+        m_committer->release(std::move(m_block.buffer));
+    }
+
+    std::size_t ConcurrentWriter::Producer::nPending() const {
+        std::size_t n = m_block.nRows;
+        for (const Block &block : m_full)
+            n += block.nRows;
+        return n;
+    }
+
+    void ConcurrentWriter::Producer::flush() {
+        if (m_committer->order() != CommitOrder::Arrival)
+            throw std::logic_error("Rows must be committed with a sequence number");
+        if (m_block.nRows == 0)
+            return;
+        std::vector<Block> blocks;
+        blocks.push_back(std::move(m_block));
+        m_block = Block{m_committer->acquire(), 0};
+        m_committer->submit(std::move(blocks), std::nullopt);
+    }
+
+    void ConcurrentWriter::Producer::commit(std::uint64_t sequence) {
+        if (m_committer->order() != CommitOrder::Sequence)
+            throw std::logic_error("Sequence numbers require CommitOrder::Sequence");
+        std::vector<Block> blocks = std::move(m_full);
+        m_full.clear();
+        if (m_block.nRows) {
+            blocks.push_back(std::move(m_block));
+            m_block = Block{m_committer->acquire(), 0};
+        }
+        m_committer->submit(std::move(blocks), sequence);
+    }
+
+    void ConcurrentWriter::Producer::writeFromBuffer(const H5BufferConstView &buffer) {
+        convert(buffer, nextSlot());
+        commitSlot();
+    }
+
+    void ConcurrentWriter::Producer::writeFromBuffer(
+            const H5BufferConstView &buffer, std::size_t n) {
+        // A plain copy of vlen data would leave the block sharing the caller's memory
+        bool direct = m_directCheck.canCopyBytes(buffer.dtype());
+        const std::byte *source = static_cast<const std::byte *>(buffer.get());
+        for (std::size_t idx = 0; idx < n;) {
+            std::size_t nToWrite = std::min(n - idx, m_blockSize - m_block.nRows);
+            if (direct)
+                std::memcpy(nextSlot().get(), source + idx * m_objectSize, nToWrite * m_objectSize);
+            else
+                convert(H5BufferConstView(source + idx * buffer.footprint(), buffer.dtype()),
+                        nextSlot(), nToWrite);
+            idx += nToWrite;
+            m_block.nRows += nToWrite;
+            if (m_block.nRows == m_blockSize)
+                nextBlock();
+        }
+    }
+
+    H5BufferView ConcurrentWriter::Producer::nextSlot() {
+        return H5BufferView(m_block.buffer.get(m_block.nRows * m_objectSize), m_dtype);
+    }
+
+    void ConcurrentWriter::Producer::commitSlot() {
+        if (++m_block.nRows == m_blockSize)
+            nextBlock();
+    }
+
+    void ConcurrentWriter::Producer::nextBlock() {
+        if (m_committer->order() == CommitOrder::Arrival)
+            flush();
+        else {
+            m_full.push_back(std::move(m_block));
+            m_block = Block{m_committer->acquire(), 0};
+        }
+    }
+
+    void ConcurrentWriter::Producer::discard() {
+        m_committer->reclaim(m_block);
+        for (Block &block : m_full) {
+            m_committer->reclaim(block);
+            m_committer->release(std::move(block.buffer));
+        }
+        m_full.clear();
+    }
+
+    ConcurrentWriter::ConcurrentWriter(
+            const H5::Group &targetGroup, const std::string &name, const H5::DataType &dtype,
+            std::size_t blockSize, std::size_t chunkSize, const DataSetCreationOptions &options,
+            CommitOrder order, std::size_t maxQueued)
+            : m_dtype(dtype), m_blockSize(blockSize), m_order(order) {
+        if (blockSize == 0)
+            throw std::invalid_argument("The block size must be above 0");
+        if (maxQueued == 0)
+            throw std::invalid_argument("The queue must hold at least one block");
+        hbool_t threadsafe = false;
+        H5is_library_threadsafe(&threadsafe);
+        if (!threadsafe)
+            throw std::runtime_error(
+                    "Concurrent writing requires a thread-safe build of the H5 library");
+        if (chunkSize == SIZE_MAX && !options.autoChunk())
+            chunkSize = blockSize;
+        m_committer = std::make_unique<Committer>(
+                targetGroup, name, dtype, blockSize, chunkSize, options, order, maxQueued);
+    }
+
+    ConcurrentWriter::~ConcurrentWriter() {
+        // Cannot throw from a destructor so this is the last chance to report any error
+        try {
+            m_committer->sync();
+        } catch (const H5::Exception &e) {
+            std::cerr << "Failed to write " << dataset().getObjName() << ": " << e.getDetailMsg()
+                      << std::endl;
+        } catch (const std::exception &e) {
+            std::cerr << "Failed to write " << dataset().getObjName() << ": " << e.what()
+                      << std::endl;
+        } catch (...) {
+            std::cerr << "Failed to write " << dataset().getObjName() << ": unknown error"
+                      << std::endl;
+        }
+    }
+
+    ConcurrentWriter::Producer ConcurrentWriter::makeProducer() {
+        return Producer(*m_committer, m_dtype, m_blockSize);
+    }
+
+    void ConcurrentWriter::sync() { m_committer->sync(); }
+
+    const H5::DataSet &ConcurrentWriter::dataset() const { return m_committer->writer().dataset(); }
+
+    hsize_t ConcurrentWriter::nWritten() const { return m_committer->nWritten(); }
+} // namespace H5Composites
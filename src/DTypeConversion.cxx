@@ -3,8 +3,13 @@
 #include "H5Composites/DTypePrecision.hxx"
 #include "H5Composites/DTypePrinting.hxx"
 #include "H5Composites/DTypeUtils.hxx"
+#include "H5Composites/MemberwiseConverter.hxx"
+#include "H5Composites/VLenArena.hxx"
 
+#include <algorithm>
+#include <array>
 #include <cstring>
+#include <new>
 #include <optional>
 
 namespace {
@@ -29,6 +34,79 @@ namespace {
         for (const auto &s : source.unknown)
             target.unknown.push_back(join(prefix, s));
     }
+
+    /// @brief Whether a data type holds variable length data of any kind
+    bool hasVLenData(const H5::DataType &dtype) {
+        if (H5Tdetect_class(dtype.getId(), H5T_VLEN) > 0)
+            return true;
+        switch (dtype.getClass()) {
+        case H5T_STRING:
+            return dtype.isVariableStr();
+        case H5T_ARRAY:
+            return hasVLenData(dtype.getSuper());
+        case H5T_COMPOUND: {
+            H5::CompType compType(dtype.getId());
+            for (int idx = 0; idx < compType.getNmembers(); ++idx)
+                if (hasVLenData(compType.getMemberDataType(idx)))
+                    return true;
+            return false;
+        }
+        default:
+            return false;
+        }
+    }
+
+    /// @brief The members of a compound source which are also in the target, packed together
+    ///
+    /// Other types, and compounds which lose nothing, are returned unchanged
+    H5::DataType usedMembers(const H5::DataType &source, const H5::DataType &target) {
+        if (source.getClass() != H5T_COMPOUND || target.getClass() != H5T_COMPOUND)
+            return source;
+        H5::CompType sourceComp(source.getId());
+        H5::CompType targetComp(target.getId());
+        std::vector<std::pair<std::string, H5::DataType>> members;
+        std::size_t size = 0;
+        bool changed = false;
+        for (int idx = 0; idx < sourceComp.getNmembers(); ++idx) {
+            std::string name = sourceComp.getMemberName(idx);
+            // Use the C API as the C++ one throws for missing members
+            int targetIdx = H5Tget_member_index(targetComp.getId(), name.c_str());
+            if (targetIdx < 0) {
+                changed = true;
+                continue;
+            }
+            H5::DataType member = sourceComp.getMemberDataType(idx);
+            H5::DataType used = usedMembers(member, targetComp.getMemberDataType(targetIdx));
+            changed |= used.getId() != member.getId();
+            size += used.getSize();
+            members.emplace_back(name, used);
+        }
+        if (!changed)
+            return source;
+        H5::CompType result(std::max<std::size_t>(size, 1));
+        std::size_t offset = 0;
+        for (const auto &[name, dtype] : members) {
+            result.insertMember(name, offset, dtype);
+            offset += dtype.getSize();
+        }
+        return result;
+    }
+
+    /// @brief Get per-thread scratch memory which is reused between conversions
+    /// @param idx Which of the scratch buffers to use
+    /// @param size The minimum number of bytes required
+    void *scratch(std::size_t idx, std::size_t size) {
+        thread_local std::array<std::pair<SmartBuffer, std::size_t>, 2> buffers;
+        auto &[buffer, capacity] = buffers.at(idx);
+        if (capacity < size) {
+            // The old contents are not needed so there is no point copying them
+            buffer = SmartBuffer(size, BufferAllocator::aligned());
+            if (!buffer)
+                throw std::bad_alloc();
+            capacity = size;
+        }
+        return buffer.get();
+    }
 } // namespace
 
 namespace H5Composites {
@@ -156,6 +234,70 @@ namespace H5Composites {
         return status;
     }
 
+    ConversionPlanCache &ConversionPlanCache::instance() {
+        static ConversionPlanCache instance;
+        return instance;
+    }
+
+    std::shared_ptr<const ConversionPlan> ConversionPlanCache::get(
+            const H5::DataType &source, const H5::DataType &target) {
+        std::pair<hid_t, hid_t> key(source.getId(), target.getId());
+        {
+            std::lock_guard lock(m_mutex);
+            auto itr = m_plans.find(key);
+            if (itr != m_plans.end()) {
+                ++m_nHits;
+                return itr->second.plan;
+            }
+        }
+        ++m_nMisses;
+        // Build the plan outside of the lock, the H5 calls can be slow
+        auto plan = std::make_shared<ConversionPlan>();
+        plan->status = checkConversion(source, target);
+        plan->scratchSize = std::max(source.getSize(), target.getSize());
+        if (plan->status.impossible.empty()) {
+            H5T_cdata_t *cdata{nullptr};
+            source.find(target, &cdata);
+            if (!cdata)
+                // This is just to be *very* safe. The underlying H5 implementation should throw on
+                // the above call
+                throw std::runtime_error("Could not create cdata");
+            plan->needBackground = cdata->need_bkg;
+            plan->memberwise = MemberwiseConverter::create(source, target);
+            plan->readDType = usedMembers(source, target);
+            // Reading into memory that is never reclaimed must not allocate vlen data
+            if (!hasVLenData(plan->readDType) && plan->readDType != target)
+                plan->readMemberwise = MemberwiseConverter::create(plan->readDType, target);
+        }
+        std::lock_guard lock(m_mutex);
+        if (m_plans.size() >= m_maxSize)
+            m_plans.clear();
+        // If another thread got here first then use its plan
+        return m_plans.try_emplace(key, Entry{source, target, plan}).first->second.plan;
+    }
+
+    void ConversionPlanCache::clear() {
+        std::lock_guard lock(m_mutex);
+        m_plans.clear();
+    }
+
+    std::size_t ConversionPlanCache::size() const {
+        std::lock_guard lock(m_mutex);
+        return m_plans.size();
+    }
+
+    void ConversionPlanCache::setMaxSize(std::size_t maxSize) {
+        std::lock_guard lock(m_mutex);
+        m_maxSize = maxSize;
+        if (m_plans.size() > m_maxSize)
+            m_plans.clear();
+    }
+
+    void ConversionPlanCache::resetCounters() {
+        m_nHits = 0;
+        m_nMisses = 0;
+    }
+
     InvalidConversionError::InvalidConversionError(
             const H5::DataType &source, const H5::DataType &target,
             const ConversionCriteria &criteria)
@@ -173,29 +315,47 @@ namespace H5Composites {
     void convert(
             const H5BufferConstView &source, H5BufferView target,
             const ConversionCriteria &criteria) {
-        std::string error;
-        if (!checkConversion(source.dtype(), target.dtype()).check(error, criteria))
+        convert(source, target, 1, criteria);
+    }
+
+    void convert(
+            const H5BufferConstView &source, H5BufferView target, std::size_t n,
+            const ConversionCriteria &criteria) {
+        std::shared_ptr<const ConversionPlan> plan =
+                ConversionPlanCache::instance().get(source.dtype(), target.dtype());
+        if (!plan->status.check(criteria))
             throw InvalidConversionError(source.dtype(), target.dtype(), criteria);
-        std::size_t size = std::max(source.footprint(), target.footprint());
-        H5T_cdata_t *cdata{nullptr};
-        source.dtype().find(target.dtype(), &cdata);
-        if (!cdata)
-            // This is just to be *very* safe. The underlying H5 implementation should throw on the
-            // above call
-            throw std::runtime_error("Could not create cdata");
-        SmartBuffer background;
-        if (cdata->need_bkg != H5T_BKG_NO)
-            background = SmartBuffer(size, 0);
-        if (target.footprint() >= source.footprint()) {
+        if (n == 0)
+            return;
+        if (plan->memberwise) {
+            if (source.get() == target.get()) {
+                void *buffer = scratch(1, n * target.footprint());
+                (*plan->memberwise)(source.get(), buffer, n);
+                std::memcpy(target.get(), buffer, n * target.footprint());
+            } else
+                (*plan->memberwise)(source.get(), target.get(), n);
+            return;
+        }
+        void *background = nullptr;
+        if (plan->needBackground != H5T_BKG_NO) {
+            background = scratch(0, n * plan->scratchSize);
+            std::memset(background, 0, n * plan->scratchSize);
+        }
+        // Any vlen data created by the conversion goes into the current arena (if any)
+        const H5::PropList &propList = VLenArena::currentTransferPropList();
+        if (source.get() == target.get())
+            // In place, the caller has guaranteed that there is enough space
+            source.dtype().convert(target.dtype(), n, target.get(), background, propList);
+        else if (target.footprint() >= source.footprint()) {
             // Simple - no need to create a temporary buffer
-            std::memcpy(target.get(), source.get(), source.footprint());
-            source.dtype().convert(target.dtype(), 1, target.get(), background.get());
+            std::memcpy(target.get(), source.get(), n * source.footprint());
+            source.dtype().convert(target.dtype(), n, target.get(), background, propList);
         } else {
-            SmartBuffer buffer(size);
+            void *buffer = scratch(1, n * plan->scratchSize);
             // Copy the source data into the buffer
-            std::memcpy(buffer.get(), source.get(), source.footprint());
-            source.dtype().convert(target.dtype(), 1, buffer.get(), background.get());
-            std::memcpy(target.get(), buffer.get(), target.footprint());
+            std::memcpy(buffer, source.get(), n * source.footprint());
+            source.dtype().convert(target.dtype(), n, buffer, background, propList);
+            std::memcpy(target.get(), buffer, n * target.footprint());
         }
     }
 
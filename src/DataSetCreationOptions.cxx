@@ -0,0 +1,48 @@
+#include "H5Composites/DataSetCreationOptions.hxx"
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+namespace H5Composites {
+    void DataSetCreationOptions::apply(H5::DSetCreatPropList &propList) const {
+        if (shuffle)
+            propList.setShuffle();
+        if (deflateLevel >= 0)
+            propList.setDeflate(deflateLevel);
+        for (const Filter &filter : filters) {
+            if (H5Zfilter_avail(filter.id) <= 0) {
+                if (filter.optional)
+                    continue;
+                throw std::runtime_error(
+                        "Filter " + std::to_string(filter.id) + " is not available");
+            }
+            propList.setFilter(
+                    filter.id, filter.optional ? H5Z_FLAG_OPTIONAL : H5Z_FLAG_MANDATORY,
+                    filter.values.size(), filter.values.data());
+        }
+        if (fletcher32)
+            propList.setFletcher32();
+    }
+
+    hsize_t DataSetCreationOptions::chunkRows(std::size_t rowSize) const {
+        // H5 does not allow chunks of 4GB or more
+        constexpr std::size_t maxChunkBytes = UINT32_MAX;
+        hsize_t nRows = std::min(targetChunkBytes, maxChunkBytes) / rowSize;
+        if (expectedRows > 0)
+            nRows = std::min(nRows, expectedRows);
+        return std::max<hsize_t>(nRows, 1);
+    }
+
+    void DataSetCreationOptions::applyChunkCache(
+            H5::DSetAccPropList &propList, std::size_t chunkBytes) {
+        // The H5 default cache size is 1MB
+        constexpr std::size_t defaultCacheBytes = 1024 * 1024;
+        std::size_t cacheBytes = std::max(defaultCacheBytes, 4 * chunkBytes);
+        // H5 recommends around 100 hash slots per chunk that fits in the cache
+        std::size_t nSlots = 100 * (cacheBytes / std::max<std::size_t>(chunkBytes, 1)) + 1;
+        // Data is appended so chunks that have been fully written are the ones to evict
+        propList.setChunkCache(nSlots, cacheBytes, 1.0);
+    }
+} // namespace H5Composites
@@ -0,0 +1,354 @@
+#include "H5Composites/DataSetIndex.hxx"
+#include "H5Composites/CompDTypeUtils.hxx"
+#include "H5Composites/DTypeConversion.hxx"
+#include "H5Composites/H5Buffer.hxx"
+#include "H5Composites/Reader.hxx"
+#include "H5Composites/Writer.hxx"
+#include "H5Composites/traits/String.hxx"
+#include "H5Composites/traits/Vector.hxx"
+
+#include <algorithm>
+#include <compare>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <numeric>
+#include <stdexcept>
+
+namespace {
+    using H5Composites::H5BufferConstView;
+
+    /// The number of index entries written at once
+    constexpr std::size_t indexBlockRows = 4096;
+
+    /// Split the full path of a dataset into the path of its group and its name
+    std::pair<std::string, std::string> splitPath(const std::string &path) {
+        std::size_t pos = path.rfind('/');
+        return {pos == 0 ? "/" : path.substr(0, pos), path.substr(pos + 1)};
+    }
+
+    /// The innermost member of a compound type made from a single path
+    H5::DataType leafDType(const H5::DataType &dtype) {
+        if (dtype.getClass() != H5T_COMPOUND)
+            return dtype;
+        return leafDType(H5::CompType(dtype.getId()).getMemberDataType(0));
+    }
+
+    /// Rebuild a compound type made from a single path with a different innermost member
+    H5::DataType replaceLeaf(const H5::DataType &dtype, const H5::DataType &leaf) {
+        if (dtype.getClass() != H5T_COMPOUND)
+            return leaf;
+        H5::CompType compound(dtype.getId());
+        H5::DataType member = replaceLeaf(compound.getMemberDataType(0), leaf);
+        H5::CompType result(member.getSize());
+        result.insertMember(compound.getMemberName(0), 0, member);
+        return result;
+    }
+
+    /// Extract the text of a fixed or variable length string
+    std::string readString(const H5BufferConstView &buffer) {
+        const H5::DataType &dtype = buffer.dtype();
+        if (dtype.isVariableStr()) {
+            const char *str = *static_cast<const char *const *>(buffer.get());
+            return str ? str : "";
+        }
+        const char *str = static_cast<const char *>(buffer.get());
+        return std::string(str, strnlen(str, dtype.getSize()));
+    }
+
+    /// Keys read from a dataset, owning any strings held in them
+    class KeyTable {
+    public:
+        KeyTable(const H5::DataType &dtype, hsize_t nRows)
+                : m_dtype(dtype), m_nRows(nRows),
+                  m_buffer(nRows * dtype.getSize(), H5Composites::BufferAllocator::cache()) {
+            // Null pointers are safe to reclaim if we fail part way through filling the table
+            std::memset(m_buffer.get(), 0, nRows * dtype.getSize());
+        }
+
+        ~KeyTable() {
+            if (m_nRows)
+                H5Dvlen_reclaim(
+                        m_dtype.getId(), H5::DataSpace(1, &m_nRows).getId(), H5P_DEFAULT,
+                        m_buffer.get());
+        }
+
+        std::byte *key(std::size_t row) {
+            return static_cast<std::byte *>(m_buffer.get(row * m_dtype.getSize()));
+        }
+
+    private:
+        H5::DataType m_dtype;
+        hsize_t m_nRows;
+        H5Composites::SmartBuffer m_buffer;
+    };
+
+    template <typename T> int compareValues(const std::byte *lhs, const std::byte *rhs) {
+        T lhsValue;
+        T rhsValue;
+        std::memcpy(&lhsValue, lhs, sizeof(T));
+        std::memcpy(&rhsValue, rhs, sizeof(T));
+        // The strong order gives a consistent position to NaNs
+        std::strong_ordering order = std::strong_order(lhsValue, rhsValue);
+        return order < 0 ? -1 : (order > 0 ? 1 : 0);
+    }
+} // namespace
+
+namespace H5Composites {
+    void DataSetIndex::build(const H5::DataSet &dataset, const std::vector<std::string> &columns) {
+        if (columns.empty())
+            throw std::invalid_argument("An index needs at least one column");
+        H5::CompType dtype = dataset.getCompType();
+        hsize_t nRows;
+        dataset.getSpace().getSimpleExtentDims(&nRows);
+
+        // Work out the layout of the key before reading anything
+        std::vector<H5::DataType> projections;
+        std::vector<Column> keyColumns;
+        std::size_t keySize = 0;
+        for (const std::string &column : columns) {
+            H5::CompType projection = projectCompoundDType(dtype, {column});
+            Kind kind = kindOf(leafDType(projection));
+            projections.push_back(projection);
+            keyColumns.push_back(Column{kind, keySize});
+            keySize += storedDType(kind).getSize();
+        }
+        H5::CompType keyDType(keySize);
+        for (std::size_t idx = 0; idx < columns.size(); ++idx)
+            keyDType.insertMember(
+                    columns[idx], keyColumns[idx].offset, storedDType(keyColumns[idx].kind));
+
+        // Read each column and copy it into the keys
+        KeyTable keys(keyDType, nRows);
+        for (std::size_t idx = 0; idx < columns.size(); ++idx) {
+            const Column &column = keyColumns[idx];
+            H5::DataType leaf = leafDType(projections[idx]);
+            // Conversions between fixed and variable length strings are not supported by H5 so
+            // strings are read in their own type and copied
+            H5::DataType readDType = column.kind == Kind::String ? leaf : storedDType(column.kind);
+            std::size_t readSize = readDType.getSize();
+            Reader reader(replaceLeaf(projections[idx], readDType), dataset, 1);
+            SmartBuffer values(
+                    std::max<std::size_t>(nRows, 1) * readSize, BufferAllocator::cache());
+            std::byte *valueData = static_cast<std::byte *>(values.get());
+            reader.readInto(H5BufferView(valueData, reader.dtype()), nRows);
+            if (column.kind != Kind::String || leaf.isVariableStr())
+                // Any strings now belong to the keys
+                for (std::size_t row = 0; row < nRows; ++row)
+                    std::memcpy(
+                            keys.key(row) + column.offset, valueData + row * readSize, readSize);
+            else
+                for (std::size_t row = 0; row < nRows; ++row) {
+                    const char *str = reinterpret_cast<const char *>(valueData + row * readSize);
+                    // Allocated with malloc to be freed by the H5 reclaim
+                    char *copy = strndup(str, readSize);
+                    std::memcpy(keys.key(row) + column.offset, &copy, sizeof(char *));
+                }
+        }
+
+        std::vector<std::uint64_t> order(nRows);
+        std::iota(order.begin(), order.end(), 0);
+        // A stable sort keeps the rows for each key in increasing order
+        std::stable_sort(order.begin(), order.end(), [&](std::uint64_t lhs, std::uint64_t rhs) {
+            return compare(keyColumns, keys.key(lhs), keys.key(rhs)) < 0;
+        });
+
+        H5::DataType rowDType = H5::PredType::NATIVE_UINT64;
+        std::size_t entrySize = keySize + rowDType.getSize();
+        H5::CompType entryDType(entrySize);
+        entryDType.insertMember("key", 0, keyDType);
+        entryDType.insertMember("row", keySize, rowDType);
+
+        auto [groupPath, name] = splitPath(dataset.getObjName());
+        H5::Group group = dataset.openGroup(groupPath);
+        std::string indexName = name + suffix;
+        if (group.nameExists(indexName))
+            group.unlink(indexName);
+        // Without a cache every block goes straight to the dataset. The entries only borrow the
+        // strings held by the keys so they must never be reclaimed by the writer
+        Writer writer(group, indexName, entryDType, 0, indexBlockRows);
+        SmartBuffer block(indexBlockRows * entrySize, BufferAllocator::cache());
+        std::byte *blockData = static_cast<std::byte *>(block.get());
+        for (std::size_t first = 0; first < nRows; first += indexBlockRows) {
+            std::size_t n = std::min<std::size_t>(indexBlockRows, nRows - first);
+            for (std::size_t idx = 0; idx < n; ++idx) {
+                std::uint64_t row = order[first + idx];
+                std::memcpy(blockData + idx * entrySize, keys.key(row), keySize);
+                std::memcpy(blockData + idx * entrySize + keySize, &row, sizeof(row));
+            }
+            writer.writeFromBuffer(H5BufferConstView(blockData, entryDType), n);
+        }
+        writer.setAttribute("nRows", toBuffer<unsigned long long>(nRows));
+    }
+
+    void DataSetIndex::build(const H5::DataSet &dataset) {
+        if (!dataset.attrExists("index"))
+            throw std::invalid_argument(dataset.getObjName() + " has no index columns set");
+        H5::Attribute attr = dataset.openAttribute("index");
+        H5Buffer buffer(attr.getDataType());
+        attr.read(buffer.dtype(), buffer.get());
+        if (buffer.dtype().getClass() == H5T_STRING)
+            build(dataset, {fromBuffer<std::string>(buffer)});
+        else
+            build(dataset, fromBuffer<std::vector<std::string>>(buffer));
+    }
+
+    bool DataSetIndex::exists(const H5::DataSet &dataset) {
+        return dataset.nameExists(dataset.getObjName() + suffix);
+    }
+
+    DataSetIndex::DataSetIndex(const H5::DataSet &dataset, std::size_t cacheSize) {
+        if (!exists(dataset))
+            throw std::invalid_argument(dataset.getObjName() + " has no index");
+        m_index = dataset.openDataSet(dataset.getObjName() + suffix);
+        hsize_t nRows;
+        dataset.getSpace().getSimpleExtentDims(&nRows);
+        H5::Attribute attr = m_index.openAttribute("nRows");
+        unsigned long long nIndexed;
+        attr.read(H5::PredType::NATIVE_ULLONG, &nIndexed);
+        if (nIndexed != nRows)
+            throw std::runtime_error(
+                    "The index of " + dataset.getObjName() + " covers " +
+                    std::to_string(nIndexed) + " rows but the dataset has " +
+                    std::to_string(nRows));
+        H5::CompType entryDType = m_index.getCompType();
+        m_keyDType.copy(entryDType.getMemberCompType(0));
+        m_rowOffset = entryDType.getMemberOffset(1);
+        for (int idx = 0; idx < m_keyDType.getNmembers(); ++idx) {
+            m_columns.push_back(m_keyDType.getMemberName(idx));
+            m_keyColumns.push_back(
+                    Column{kindOf(m_keyDType.getMemberDataType(idx)),
+                           m_keyDType.getMemberOffset(idx)});
+        }
+        m_reader = std::make_unique<Reader>(m_index, cacheSize);
+    }
+
+    DataSetIndex::~DataSetIndex() = default;
+
+    std::vector<std::size_t> DataSetIndex::equalRange(const std::vector<H5BufferConstView> &key) {
+        auto [first, last] = search(key);
+        std::vector<std::size_t> rows;
+        rows.reserve(last - first);
+        for (std::size_t entry = first; entry < last; ++entry)
+            rows.push_back(row(entry));
+        return rows;
+    }
+
+    std::optional<std::size_t> DataSetIndex::find(const std::vector<H5BufferConstView> &key) {
+        auto [first, last] = search(key);
+        if (first == last)
+            return std::nullopt;
+        return row(first);
+    }
+
+    DataSetIndex::Kind DataSetIndex::kindOf(const H5::DataType &dtype) {
+        switch (dtype.getClass()) {
+        case H5T_INTEGER:
+            return H5::IntType(dtype.getId()).getSign() == H5T_SGN_NONE ? Kind::Unsigned
+                                                                         : Kind::Signed;
+        case H5T_FLOAT:
+            return Kind::Float;
+        case H5T_STRING:
+            return Kind::String;
+        default:
+            throw std::invalid_argument(
+                    "Only integer, floating point and string members can be used in an index");
+        }
+    }
+
+    H5::DataType DataSetIndex::storedDType(Kind kind) {
+        switch (kind) {
+        case Kind::Signed:
+            return H5::PredType::NATIVE_INT64;
+        case Kind::Unsigned:
+            return H5::PredType::NATIVE_UINT64;
+        case Kind::Float:
+            return H5::PredType::NATIVE_DOUBLE;
+        default:
+            return H5::StrType(H5::PredType::C_S1, H5T_VARIABLE);
+        }
+    }
+
+    int DataSetIndex::compare(
+            const std::vector<Column> &columns, const void *lhs, const void *rhs) {
+        for (const Column &column : columns) {
+            const std::byte *lhsValue = static_cast<const std::byte *>(lhs) + column.offset;
+            const std::byte *rhsValue = static_cast<const std::byte *>(rhs) + column.offset;
+            int result = 0;
+            switch (column.kind) {
+            case Kind::Signed:
+                result = compareValues<std::int64_t>(lhsValue, rhsValue);
+                break;
+            case Kind::Unsigned:
+                result = compareValues<std::uint64_t>(lhsValue, rhsValue);
+                break;
+            case Kind::Float:
+                result = compareValues<double>(lhsValue, rhsValue);
+                break;
+            case Kind::String: {
+                const char *lhsStr;
+                const char *rhsStr;
+                std::memcpy(&lhsStr, lhsValue, sizeof(char *));
+                std::memcpy(&rhsStr, rhsValue, sizeof(char *));
+                result = std::strcmp(lhsStr ? lhsStr : "", rhsStr ? rhsStr : "");
+                break;
+            }
+            }
+            if (result != 0)
+                return result;
+        }
+        return 0;
+    }
+
+    std::size_t DataSetIndex::bound(const void *key, bool upper) {
+        std::size_t first = 0;
+        std::size_t count = m_reader->size();
+        while (count > 0) {
+            std::size_t step = count / 2;
+            // The key is the first member of each entry
+            int result = compare(m_keyColumns, m_reader->read(first + step).get(), key);
+            if (upper ? result <= 0 : result < 0) {
+                first += step + 1;
+                count -= step + 1;
+            } else
+                count = step;
+        }
+        return first;
+    }
+
+    std::size_t DataSetIndex::row(std::size_t entry) {
+        std::uint64_t value;
+        std::memcpy(
+                &value,
+                static_cast<const std::byte *>(m_reader->read(entry).get()) + m_rowOffset,
+                sizeof(value));
+        return value;
+    }
+
+    std::pair<std::size_t, std::size_t> DataSetIndex::search(
+            const std::vector<H5BufferConstView> &key) {
+        if (key.size() != m_keyColumns.size())
+            throw std::invalid_argument(
+                    "Expected " + std::to_string(m_keyColumns.size()) + " key values, received " +
+                    std::to_string(key.size()));
+        SmartBuffer probe(m_keyDType.getSize());
+        std::byte *probeData = static_cast<std::byte *>(probe.get());
+        // The probe only borrows the strings
+        std::vector<std::string> strings(key.size());
+        for (std::size_t idx = 0; idx < key.size(); ++idx) {
+            const Column &column = m_keyColumns[idx];
+            if (column.kind == Kind::String) {
+                if (key[idx].dtype().getClass() != H5T_STRING)
+                    throw std::invalid_argument("Index column " + m_columns[idx] + " is a string");
+                strings[idx] = readString(key[idx]);
+                const char *str = strings[idx].c_str();
+                std::memcpy(probeData + column.offset, &str, sizeof(char *));
+            } else
+                convert(key[idx],
+                        H5BufferView(probeData + column.offset, storedDType(column.kind)));
+        }
+        std::size_t first = bound(probeData, false);
+        return {first, bound(probeData, true)};
+    }
+} // namespace H5Composites
@@ -1,17 +1,24 @@
 #include "H5Composites/DataSetUtils.hxx"
 #include "H5Composites/CommonDTypeUtils.hxx"
+#include "H5Composites/DTypeConversion.hxx"
+#include "H5Composites/MemberwiseConverter.hxx"
 #include "H5Composites/SmartBuffer.hxx"
 
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <map>
+#include <mutex>
 #include <ranges>
 #include <stdexcept>
+#include <thread>
 
 namespace {
     template <std::ranges::input_range Range, class Proj = std::identity>
     auto all_equal(Range &&r, Proj proj = {}) {
         auto start = std::ranges::begin(r);
         auto first = proj(*start);
-        auto itr = start + 1;
-        while (itr != std::ranges::end(r))
+        for (auto itr = start + 1; itr != std::ranges::end(r); ++itr)
             if (first != proj(*itr))
                 return false;
         return true;
@@ -29,6 +36,301 @@ namespace {
     template <std::ranges::input_range Range> auto to_vector(Range &&r) {
         return std::vector(std::ranges::begin(r), std::ranges::end(r));
     }
+
+    /// @brief Select a block of rows along the merge axis of a dataset
+    /// @return The memory space for the block and the selected dataset space
+    std::pair<H5::DataSpace, H5::DataSpace> selectRows(
+            const H5::DataSet &dataset, hsize_t mergeAxis, hsize_t position, hsize_t nRows) {
+        H5::DataSpace space = dataset.getSpace();
+        std::vector<hsize_t> size(space.getSimpleExtentNdims(), 0);
+        space.getSimpleExtentDims(size.data());
+        std::vector<hsize_t> offset(size.size(), 0);
+        size.at(mergeAxis) = nRows;
+        offset.at(mergeAxis) = position;
+        space.selectHyperslab(H5S_SELECT_SET, size.data(), offset.data());
+        return {H5::DataSpace(size.size(), size.data()), space};
+    }
+
+    /// @brief Whether the data type holds anything that points elsewhere in its file
+    bool isFileDependent(const H5::DataType &dtype) {
+        switch (dtype.getClass()) {
+        case H5T_VLEN:
+        case H5T_REFERENCE:
+            return true;
+        case H5T_STRING:
+            return dtype.isVariableStr();
+        case H5T_ARRAY:
+            return isFileDependent(dtype.getSuper());
+        case H5T_COMPOUND: {
+            H5::CompType compType(dtype.getId());
+            for (int idx = 0; idx < compType.getNmembers(); ++idx)
+                if (isFileDependent(compType.getMemberDataType(idx)))
+                    return true;
+            return false;
+        }
+        default:
+            return false;
+        }
+    }
+
+    /// @brief Whether two property lists describe the same filter pipeline
+    bool sameFilters(const H5::DSetCreatPropList &lhs, const H5::DSetCreatPropList &rhs) {
+        int nFilters = lhs.getNfilters();
+        if (nFilters != rhs.getNfilters())
+            return false;
+        for (int idx = 0; idx < nFilters; ++idx) {
+            unsigned int flags[2];
+            std::size_t nValues[2]{16, 16};
+            std::vector<unsigned int> values[2]{
+                    std::vector<unsigned int>(16), std::vector<unsigned int>(16)};
+            H5Z_filter_t ids[2];
+            for (std::size_t iList = 0; iList < 2; ++iList) {
+                hid_t plist = (iList == 0 ? lhs : rhs).getId();
+                ids[iList] = H5Pget_filter2(
+                        plist, idx, &flags[iList], &nValues[iList], values[iList].data(), 0,
+                        nullptr, nullptr);
+                if (nValues[iList] > values[iList].size()) {
+                    values[iList].resize(nValues[iList]);
+                    H5Pget_filter2(
+                            plist, idx, &flags[iList], &nValues[iList], values[iList].data(), 0,
+                            nullptr, nullptr);
+                }
+                values[iList].resize(nValues[iList]);
+            }
+            if (ids[0] != ids[1] || flags[0] != flags[1] || values[0] != values[1])
+                return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Copy whole chunks from the source to the target without decoding them
+     *
+     * This is only possible when both datasets have the same data type, chunk shape and filters,
+     * the data type contains nothing that refers to other parts of the file and the current
+     * position is on a chunk boundary.
+     *
+     * @return The number of rows copied. Any rows after this (the final partial chunk) still have
+     *         to be copied element-wise
+     */
+    hsize_t copyRawChunks(
+            H5::DataSet &target, const H5::DataSet &source, hsize_t mergeAxis,
+            hsize_t currentPosition) {
+        H5::DSetCreatPropList targetProps = target.getCreatePlist();
+        H5::DSetCreatPropList sourceProps = source.getCreatePlist();
+        if (targetProps.getLayout() != H5D_CHUNKED || sourceProps.getLayout() != H5D_CHUNKED)
+            return 0;
+        H5::DataType dtype = target.getDataType();
+        if (!(dtype == source.getDataType()) || isFileDependent(dtype) ||
+            !sameFilters(targetProps, sourceProps))
+            return 0;
+        int nDims = target.getSpace().getSimpleExtentNdims();
+        std::vector<hsize_t> chunkDims(nDims, 0);
+        std::vector<hsize_t> sourceChunkDims(nDims, 0);
+        if (targetProps.getChunk(nDims, chunkDims.data()) != nDims ||
+            sourceProps.getChunk(nDims, sourceChunkDims.data()) != nDims ||
+            chunkDims != sourceChunkDims || currentPosition % chunkDims.at(mergeAxis) != 0)
+            return 0;
+        std::vector<hsize_t> limits(nDims, 0);
+        source.getSpace().getSimpleExtentDims(limits.data());
+        limits.at(mergeAxis) -= limits.at(mergeAxis) % chunkDims.at(mergeAxis);
+        hsize_t nRows = limits.at(mergeAxis);
+        if (std::ranges::find(limits, 0) != limits.end())
+            return nRows;
+        // Step through every chunk in the source. Unallocated chunks are left that way in the
+        // target
+        std::vector<hsize_t> offset(nDims, 0);
+        H5Composites::SmartBuffer buffer;
+        std::size_t bufferSize = 0;
+        while (true) {
+            unsigned int filterMask = 0;
+            haddr_t address;
+            hsize_t size;
+            if (H5Dget_chunk_info_by_coord(
+                        source.getId(), offset.data(), &filterMask, &address, &size) < 0)
+                throw H5::DataSetIException(
+                        "H5Composites::copyRawChunks", "Failed to get chunk information");
+            if (address != HADDR_UNDEF) {
+                if (size > bufferSize) {
+                    buffer = H5Composites::SmartBuffer(size);
+                    bufferSize = size;
+                }
+                if (H5Dread_chunk(
+                            source.getId(), H5P_DEFAULT, offset.data(), &filterMask,
+                            buffer.get()) < 0)
+                    throw H5::DataSetIException(
+                            "H5Composites::copyRawChunks", "Failed to read chunk");
+                offset[mergeAxis] += currentPosition;
+                herr_t status = H5Dwrite_chunk(
+                        target.getId(), H5P_DEFAULT, filterMask, offset.data(), size,
+                        buffer.get());
+                offset[mergeAxis] -= currentPosition;
+                if (status < 0)
+                    throw H5::DataSetIException(
+                            "H5Composites::copyRawChunks", "Failed to write chunk");
+            }
+            // Move to the next chunk, last axis fastest
+            int axis = nDims - 1;
+            for (; axis >= 0; --axis) {
+                offset[axis] += chunkDims[axis];
+                if (offset[axis] < limits[axis])
+                    break;
+                offset[axis] = 0;
+            }
+            if (axis < 0)
+                break;
+        }
+        return nRows;
+    }
+
+    /// A block of rows to be copied from one of the sources to the target
+    struct MergeBlock {
+        std::size_t sourceIdx;
+        hsize_t sourcePosition;
+        hsize_t targetPosition;
+        hsize_t nRows;
+    };
+
+    /**
+     * @brief Copy blocks from the sources to the target using background threads to read
+     *
+     * The reader threads pull blocks in order and read them into buffers. The calling thread
+     * writes the blocks strictly in order, so the output is independent of how the reads are
+     * scheduled. At most nBuffers blocks are held in memory at once.
+     *
+     * The H5 library only runs one call at a time, so the reads and writes themselves never
+     * overlap. Where a MemberwiseConverter can convert a source to the target type the readers
+     * read in the source's own type and convert outside of H5, which can run in parallel with
+     * the next read or write. Other sources are converted by H5 during the read.
+     */
+    void pipelinedMerge(
+            H5::DataSet &target, const std::vector<H5::DataSet> &sources,
+            const std::vector<MergeBlock> &blocks, hsize_t mergeAxis, std::size_t rowBytes,
+            std::size_t nRowsInBuffer, std::size_t nThreads) {
+        H5::DataType dtype = target.getDataType();
+        std::size_t rowElements = rowBytes / dtype.getSize();
+        // The converters for the sources that can be read in their own type
+        std::vector<std::shared_ptr<const H5Composites::MemberwiseConverter>> converters;
+        std::vector<H5::DataType> sourceDTypes;
+        for (const H5::DataSet &source : sources) {
+            H5::DataType sourceDType = source.getDataType();
+            converters.push_back(
+                    sourceDType == dtype ? nullptr
+                                         : H5Composites::ConversionPlanCache::instance()
+                                                   .get(sourceDType, dtype)
+                                                   ->memberwise);
+            sourceDTypes.push_back(std::move(sourceDType));
+        }
+        std::size_t nBuffers = 2 * nThreads;
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::vector<H5Composites::SmartBuffer> freeBuffers;
+        std::map<std::size_t, H5Composites::SmartBuffer> readBlocks;
+        std::size_t nextRead = 0;
+        std::size_t nextWrite = 0;
+        bool stop = false;
+        std::exception_ptr error;
+
+        auto readLoop = [&]() {
+            // Rows in the source type waiting to be converted
+            H5Composites::SmartBuffer staging;
+            std::size_t stagingSize = 0;
+            while (true) {
+                std::size_t idx;
+                H5Composites::SmartBuffer buffer;
+                {
+                    std::unique_lock lock(mutex);
+                    cv.wait(lock, [&] {
+                        return stop || error || nextRead == blocks.size() ||
+                               nextRead < nextWrite + nBuffers;
+                    });
+                    if (stop || error || nextRead == blocks.size())
+                        return;
+                    idx = nextRead++;
+                    if (!freeBuffers.empty()) {
+                        buffer = std::move(freeBuffers.back());
+                        freeBuffers.pop_back();
+                    }
+                }
+                try {
+                    if (!buffer)
+                        buffer = H5Composites::SmartBuffer(
+                                nRowsInBuffer * rowBytes,
+                                H5Composites::BufferAllocator::cache());
+                    const MergeBlock &block = blocks[idx];
+                    const H5::DataSet &source = sources[block.sourceIdx];
+                    auto [memorySpace, sourceSpace] =
+                            selectRows(source, mergeAxis, block.sourcePosition, block.nRows);
+                    if (const auto &converter = converters[block.sourceIdx]) {
+                        std::size_t nElements = block.nRows * rowElements;
+                        if (stagingSize < nElements * converter->sourceSize()) {
+                            stagingSize = nElements * converter->sourceSize();
+                            staging = H5Composites::SmartBuffer(
+                                    stagingSize, H5Composites::BufferAllocator::cache());
+                        }
+                        source.read(
+                                staging.get(), sourceDTypes[block.sourceIdx], memorySpace,
+                                sourceSpace);
+                        (*converter)(staging.get(), buffer.get(), nElements);
+                    } else
+                        source.read(buffer.get(), dtype, memorySpace, sourceSpace);
+                    std::lock_guard lock(mutex);
+                    readBlocks.emplace(idx, std::move(buffer));
+                } catch (...) {
+                    std::lock_guard lock(mutex);
+                    error = std::current_exception();
+                }
+                cv.notify_all();
+            }
+        };
+
+        std::vector<std::thread> threads;
+        for (std::size_t idx = 0; idx < nThreads; ++idx)
+            threads.emplace_back(readLoop);
+        try {
+            for (; nextWrite < blocks.size();) {
+                H5Composites::SmartBuffer buffer;
+                {
+                    std::unique_lock lock(mutex);
+                    cv.wait(lock, [&] { return error || readBlocks.count(nextWrite); });
+                    if (error)
+                        std::rethrow_exception(error);
+                    auto itr = readBlocks.find(nextWrite);
+                    buffer = std::move(itr->second);
+                    readBlocks.erase(itr);
+                }
+                const MergeBlock &block = blocks[nextWrite];
+                auto [memorySpace, targetSpace] =
+                        selectRows(target, mergeAxis, block.targetPosition, block.nRows);
+                target.write(buffer.get(), dtype, memorySpace, targetSpace);
+                H5Dvlen_reclaim(dtype.getId(), memorySpace.getId(), H5P_DEFAULT, buffer.get());
+                {
+                    std::lock_guard lock(mutex);
+                    freeBuffers.push_back(std::move(buffer));
+                    ++nextWrite;
+                }
+                cv.notify_all();
+            }
+        } catch (...) {
+            {
+                std::lock_guard lock(mutex);
+                stop = true;
+            }
+            cv.notify_all();
+            for (std::thread &thread : threads)
+                thread.join();
+            // Free the vlen data from anything that was read but not written
+            for (auto &[idx, buffer] : readBlocks)
+                H5Dvlen_reclaim(
+                        dtype.getId(),
+                        selectRows(sources[blocks[idx].sourceIdx], mergeAxis, 0, blocks[idx].nRows)
+                                .first.getId(),
+                        H5P_DEFAULT, buffer.get());
+            throw;
+        }
+        for (std::thread &thread : threads)
+            thread.join();
+    }
 } // namespace
 
 namespace H5Composites {
@@ -85,16 +387,20 @@ namespace H5Composites {
         for (hsize_t idx = 0; idx < nDims; ++idx)
             if (idx != mergeAxis)
                 nElementsPerRow *= dims[idx];
+        hsize_t nRawRows = copyRawChunks(target, source, mergeAxis, currentPosition);
         std::vector<hsize_t> targetOffset(nDims, 0);
-        targetOffset.at(mergeAxis) = currentPosition;
+        targetOffset.at(mergeAxis) = currentPosition + nRawRows;
         std::vector<hsize_t> sourceOffset(nDims, 0);
+        sourceOffset.at(mergeAxis) = nRawRows;
         std::vector<hsize_t> sourceDims(nDims, 0);
         source.getSpace().getSimpleExtentDims(sourceDims.data());
         std::size_t nSourceRows = sourceDims.at(mergeAxis);
+        if (nRawRows == nSourceRows)
+            return targetOffset[mergeAxis];
         SmartBuffer buffer(
-                nElementsPerRow * std::min(nRowsInBuffer, nSourceRows) *
+                nElementsPerRow * std::min<std::size_t>(nRowsInBuffer, nSourceRows - nRawRows) *
                 target.getDataType().getSize());
-        for (std::size_t iRow = 0; iRow < nSourceRows; iRow += nRowsInBuffer) {
+        for (std::size_t iRow = nRawRows; iRow < nSourceRows; iRow += nRowsInBuffer) {
             std::vector<hsize_t> sourceSize = sourceDims;
             std::size_t nRowsToWrite = std::min(nRowsInBuffer, nSourceRows - iRow);
             sourceSize[mergeAxis] = nRowsToWrite;
@@ -117,10 +423,51 @@ namespace H5Composites {
         return targetOffset[mergeAxis];
     }
 
+    hsize_t extendDataSet(
+            H5::DataSet &target, const std::vector<H5::DataSet> &sources, hsize_t mergeAxis,
+            hsize_t currentPosition, std::size_t nRowsInBuffer, std::size_t nThreads) {
+        if (nThreads == 0) {
+            for (const H5::DataSet &source : sources)
+                currentPosition =
+                        extendDataSet(target, source, mergeAxis, currentPosition, nRowsInBuffer);
+            return currentPosition;
+        }
+        hbool_t threadsafe = false;
+        H5is_library_threadsafe(&threadsafe);
+        if (!threadsafe)
+            throw std::runtime_error("Threaded merging requires a thread-safe H5 library");
+        // Work out the size of a single row
+        hsize_t nDims = target.getSpace().getSimpleExtentNdims();
+        std::vector<hsize_t> dims(nDims, 0);
+        target.getSpace().getSimpleExtentDims(dims.data());
+        std::size_t rowBytes = target.getDataType().getSize();
+        for (hsize_t idx = 0; idx < nDims; ++idx)
+            if (idx != mergeAxis)
+                rowBytes *= dims[idx];
+        // Lay out all of the blocks in advance so that the output order is fixed
+        std::vector<MergeBlock> blocks;
+        for (std::size_t sourceIdx = 0; sourceIdx < sources.size(); ++sourceIdx) {
+            std::vector<hsize_t> sourceDims(nDims, 0);
+            sources[sourceIdx].getSpace().getSimpleExtentDims(sourceDims.data());
+            hsize_t nSourceRows = sourceDims.at(mergeAxis);
+            // Whole chunks that can be copied directly are done here, before the threads start
+            hsize_t nRawRows =
+                    copyRawChunks(target, sources[sourceIdx], mergeAxis, currentPosition);
+            currentPosition += nRawRows;
+            for (hsize_t iRow = nRawRows; iRow < nSourceRows; iRow += nRowsInBuffer) {
+                hsize_t nRows = std::min<hsize_t>(nRowsInBuffer, nSourceRows - iRow);
+                blocks.push_back(MergeBlock{sourceIdx, iRow, currentPosition, nRows});
+                currentPosition += nRows;
+            }
+        }
+        pipelinedMerge(target, sources, blocks, mergeAxis, rowBytes, nRowsInBuffer, nThreads);
+        return currentPosition;
+    }
+
     void mergeDataSets(
             H5::Group &targetGroup, const std::string &name,
             const std::vector<H5::DataSet> &datasets, std::size_t maxBufferSize,
-            hsize_t defaultMergeAxis) {
+            hsize_t defaultMergeAxis, const DataSetCreationOptions &options, std::size_t nThreads) {
         std::pair<hsize_t, std::vector<hsize_t>> extentInfo =
                 getMergedDataSetExtent(datasets, defaultMergeAxis);
         hsize_t mergeAxis = extentInfo.first;
@@ -138,19 +485,24 @@ namespace H5Composites {
         if (nRowsInBuffer == 0)
             throw std::invalid_argument("Not enough space in buffer for a single row!");
         std::vector<hsize_t> chunkSize = fullDims;
-        chunkSize[mergeAxis] = nRowsInBuffer;
+        if (options.autoChunk()) {
+            DataSetCreationOptions chunkOptions = options;
+            if (chunkOptions.expectedRows == 0)
+                chunkOptions.expectedRows = fullDims.at(mergeAxis);
+            chunkSize[mergeAxis] = chunkOptions.chunkRows(rowSize);
+        } else
+            chunkSize[mergeAxis] = nRowsInBuffer;
         // Now create the dataset
         H5::DSetCreatPropList propList = H5P_DATASET_CREATE_DEFAULT;
         propList.setChunk(chunkSize.size(), chunkSize.data());
-        // TODO: compression level?
+        options.apply(propList);
+        H5::DSetAccPropList accessPropList;
+        DataSetCreationOptions::applyChunkCache(accessPropList, chunkSize[mergeAxis] * rowSize);
         // Now create the dataset
         H5::DataSet target = targetGroup.createDataSet(
                 name, common, H5::DataSpace(fullDims.size(), fullDims.data(), maxDims.data()),
-                propList);
-        hsize_t currentPosition = 0;
-        for (const H5::DataSet &dset : datasets)
-            currentPosition =
-                    extendDataSet(target, dset, mergeAxis, currentPosition, nRowsInBuffer);
+                propList, accessPropList);
+        extendDataSet(target, datasets, mergeAxis, 0, nRowsInBuffer, nThreads);
     }
 
 } // namespace H5Composites
\ No newline at end of file
@@ -19,6 +19,33 @@ namespace H5Composites {
         return GroupWrapper(file, typeRegister);
     }
 
+#ifdef H5_HAVE_PARALLEL
+    GroupWrapper GroupWrapper::readFile(
+            const std::string &name, MPI_Comm comm, MPI_Info info, bool update) {
+        H5::FileAccPropList accessPropList;
+        H5Pset_fapl_mpio(accessPropList.getId(), comm, info);
+        H5::H5File file(
+                name, update ? H5F_ACC_RDWR : H5F_ACC_RDONLY, H5::FileCreatPropList::DEFAULT,
+                accessPropList);
+        return GroupWrapper(
+                file, hasTypeRegister(file) ? getTypeRegister(file)
+                                            : TypeRegister::instance().enumType());
+    }
+
+    GroupWrapper GroupWrapper::createFile(
+            const std::string &name, MPI_Comm comm, MPI_Info info, bool overwrite) {
+        H5::FileAccPropList accessPropList;
+        H5Pset_fapl_mpio(accessPropList.getId(), comm, info);
+        H5::H5File file(
+                name, overwrite ? H5F_ACC_TRUNC : H5F_ACC_CREAT, H5::FileCreatPropList::DEFAULT,
+                accessPropList);
+        H5::EnumType typeRegister;
+        typeRegister.copy(TypeRegister::instance().enumType());
+        typeRegister.commit(file, "TypeRegister");
+        return GroupWrapper(file, typeRegister);
+    }
+#endif
+
     bool GroupWrapper::hasTypeRegister(const H5::Group &group) {
         return group.exists("TypeRegister");
     }
@@ -55,8 +82,25 @@ namespace H5Composites {
 
     Writer GroupWrapper::makeDataSetWriter(
             const std::string &name, const H5::DataType &dtype, std::size_t cacheSize,
-            std::size_t chunkSize) {
-        return Writer(m_group, name, dtype, cacheSize, chunkSize);
+            std::size_t chunkSize, const DataSetCreationOptions &options) {
+        return Writer(m_group, name, dtype, cacheSize, chunkSize, options);
+    }
+
+    ColumnarWriter GroupWrapper::makeColumnarWriter(
+            const std::string &name, const H5::DataType &dtype, std::size_t cacheSize,
+            std::size_t chunkSize, const DataSetCreationOptions &options) {
+        return ColumnarWriter(m_group, name, dtype, cacheSize, chunkSize, options);
+    }
+
+    ColumnarReader GroupWrapper::makeColumnarReader(
+            const std::string &name, std::size_t cacheSize) const {
+        return ColumnarReader(m_group.openGroup(name), cacheSize);
+    }
+
+    ColumnarReader GroupWrapper::makeColumnarReader(
+            const std::string &name, const std::vector<std::string> &members,
+            std::size_t cacheSize) const {
+        return ColumnarReader(m_group.openGroup(name), members, cacheSize);
     }
 
 } // namespace H5Composites
\ No newline at end of file
@@ -9,11 +9,13 @@
  */
 
 #include "H5Composites/H5Buffer.hxx"
+#include "H5Composites/VLenArena.hxx"
 
 namespace H5Composites {
     H5Buffer::H5Buffer(const H5::DataType &dtype)
-            : H5BufferView(nullptr, dtype), m_buffer(dtype.getSize()),
-              m_vlenDeleter(m_buffer.get(), dtype) {
+            : H5BufferView(nullptr, dtype), m_buffer(dtype.getSize(), BufferAllocator::pooled()),
+              m_vlenDeleter(
+                      m_buffer.get(), dtype, H5S_SCALAR, VLenArena::currentTransferPropList()) {
         H5BufferConstView::m_buffer = m_buffer.get();
     }
 
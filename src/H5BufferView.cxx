@@ -1,6 +1,7 @@
 #include "H5Composites/H5BufferView.hxx"
 #include "H5Composites/DTypeConversion.hxx"
 
+#include <cstring>
 #include <stdexcept>
 
 namespace {
@@ -1,6 +1,8 @@
 #include "H5Composites/H5VLen.hxx"
 #include "H5Composites/ArrayDTypeUtils.hxx"
 
+#include <cstring>
+
 namespace H5Composites {
     H5BufferConstView getVLenArray(const H5BufferConstView &buffer) {
         H5::VarLenType dtype = buffer.dtype().getId();
@@ -0,0 +1,83 @@
+#include "H5Composites/IOMetrics.hxx"
+
+namespace H5Composites {
+    IOMetrics &IOMetrics::operator+=(const IOMetrics &other) {
+        rows += other.rows;
+        bytes += other.bytes;
+        blocks += other.blocks;
+        conversionTime += other.conversionTime;
+        ioTime += other.ioTime;
+        extendTime += other.extendTime;
+        reclaimTime += other.reclaimTime;
+        return *this;
+    }
+
+    IOMetricsRecorder::IOMetricsRecorder(Source source) : m_source(source) {
+        MetricsRegistry::instance().add(this);
+    }
+
+    IOMetricsRecorder::~IOMetricsRecorder() { MetricsRegistry::instance().remove(this); }
+
+    IOMetrics IOMetricsRecorder::snapshot() const {
+        auto time = [this](Timer timer) {
+            return std::chrono::nanoseconds(
+                    m_times[static_cast<std::size_t>(timer)].load(std::memory_order_relaxed));
+        };
+        return IOMetrics{
+                m_rows.load(std::memory_order_relaxed),
+                m_bytes.load(std::memory_order_relaxed),
+                m_blocks.load(std::memory_order_relaxed),
+                time(Timer::Conversion),
+                time(Timer::IO),
+                time(Timer::Extend),
+                time(Timer::Reclaim)};
+    }
+
+    void IOMetricsRecorder::reset() {
+        m_rows = 0;
+        m_bytes = 0;
+        m_blocks = 0;
+        for (std::atomic<std::int64_t> &time : m_times)
+            time = 0;
+    }
+
+    MetricsRegistry &MetricsRegistry::instance() {
+        static MetricsRegistry registry;
+        return registry;
+    }
+
+    IOMetrics MetricsRegistry::totals(IOMetricsRecorder::Source source) const {
+        std::size_t idx = static_cast<std::size_t>(source);
+        std::lock_guard lock(m_mutex);
+        IOMetrics total = m_retired[idx];
+        for (const IOMetricsRecorder *recorder : m_live[idx])
+            total += recorder->snapshot();
+        return total;
+    }
+
+    std::size_t MetricsRegistry::nLive(IOMetricsRecorder::Source source) const {
+        std::lock_guard lock(m_mutex);
+        return m_live[static_cast<std::size_t>(source)].size();
+    }
+
+    void MetricsRegistry::reset() {
+        std::lock_guard lock(m_mutex);
+        for (std::size_t idx = 0; idx < m_live.size(); ++idx) {
+            m_retired[idx] = {};
+            for (IOMetricsRecorder *recorder : m_live[idx])
+                recorder->reset();
+        }
+    }
+
+    void MetricsRegistry::add(IOMetricsRecorder *recorder) {
+        std::lock_guard lock(m_mutex);
+        m_live[static_cast<std::size_t>(recorder->source())].insert(recorder);
+    }
+
+    void MetricsRegistry::remove(IOMetricsRecorder *recorder) {
+        std::size_t idx = static_cast<std::size_t>(recorder->source());
+        std::lock_guard lock(m_mutex);
+        m_live[idx].erase(recorder);
+        m_retired[idx] += recorder->snapshot();
+    }
+} // namespace H5Composites
@@ -0,0 +1,539 @@
+#include "H5Composites/MemberwiseConverter.hxx"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+// Vector kernels are compiled for each instruction set and picked when first used
+#define H5COMPOSITES_X86_DISPATCH
+#include <immintrin.h>
+#endif
+
+namespace {
+    using H5Composites::MemberwiseConverter;
+
+    using NumericTypes = std::tuple<
+            std::int8_t, std::uint8_t, std::int16_t, std::uint16_t, std::int32_t, std::uint32_t,
+            std::int64_t, std::uint64_t, float, double>;
+    constexpr std::size_t nNumeric = std::tuple_size_v<NumericTypes>;
+
+    /// A numeric type recognised by the converter
+    struct NumericInfo {
+        /// The index in NumericTypes of the equivalent native type
+        std::size_t index;
+        /// Whether the type has the opposite byte order to the native type
+        bool swapped;
+    };
+
+    /// Get the equivalent native numeric type, if there is one
+    std::optional<NumericInfo> numericInfo(const H5::DataType &dtype) {
+        static const std::array<H5::PredType, nNumeric> natives{
+                H5::PredType::NATIVE_INT8,   H5::PredType::NATIVE_UINT8,
+                H5::PredType::NATIVE_INT16,  H5::PredType::NATIVE_UINT16,
+                H5::PredType::NATIVE_INT32,  H5::PredType::NATIVE_UINT32,
+                H5::PredType::NATIVE_INT64,  H5::PredType::NATIVE_UINT64,
+                H5::PredType::NATIVE_FLOAT,  H5::PredType::NATIVE_DOUBLE};
+        H5T_class_t cls = dtype.getClass();
+        if (cls != H5T_INTEGER && cls != H5T_FLOAT)
+            return std::nullopt;
+        H5T_order_t nativeOrder = H5Tget_order(H5::PredType::NATIVE_INT.getId());
+        bool swapped = H5Tget_order(dtype.getId()) != nativeOrder;
+        H5::DataType native = dtype;
+        if (swapped) {
+            // Compare a copy with the byte order flipped, everything else has to match
+            native.copy(dtype);
+            if (H5Tset_order(native.getId(), nativeOrder) < 0)
+                return std::nullopt;
+        }
+        for (std::size_t idx = 0; idx < nNumeric; ++idx)
+            if (native == natives[idx])
+                return NumericInfo{idx, swapped};
+        return std::nullopt;
+    }
+
+    /// Whether the type can be copied byte for byte
+    bool isPlainData(const H5::DataType &dtype) {
+        switch (dtype.getClass()) {
+        case H5T_VLEN:
+        case H5T_REFERENCE:
+            return false;
+        case H5T_STRING:
+            return !dtype.isVariableStr();
+        case H5T_ARRAY:
+            return isPlainData(dtype.getSuper());
+        case H5T_COMPOUND: {
+            H5::CompType compType(dtype.getId());
+            for (int idx = 0; idx < compType.getNmembers(); ++idx)
+                if (!isPlainData(compType.getMemberDataType(idx)))
+                    return false;
+            return true;
+        }
+        default:
+            return true;
+        }
+    }
+
+    /// The number of objects converted at once, keeping the block in cache between steps
+    constexpr std::size_t tileSize = 256;
+
+    template <typename S, typename D> D castValue(S value) {
+        if constexpr (std::is_integral_v<D> && !std::is_same_v<S, D>) {
+            // Saturate at the limits of the target, as H5 does
+            constexpr D min = std::numeric_limits<D>::min();
+            constexpr D max = std::numeric_limits<D>::max();
+            if constexpr (std::is_floating_point_v<S>) {
+                if (std::isnan(value))
+                    return 0;
+                if (value <= static_cast<S>(min))
+                    return min;
+                if (value >= static_cast<S>(max))
+                    return max;
+            } else {
+                if (std::cmp_less(value, min))
+                    return min;
+                if (std::cmp_greater(value, max))
+                    return max;
+            }
+        }
+        return static_cast<D>(value);
+    }
+
+    /// Convert n contiguous values. Written without branches so that it is vectorised
+    template <typename S, typename D>
+    void convertContiguous(const std::byte *source, std::byte *target, std::size_t n) {
+        for (std::size_t idx = 0; idx < n; ++idx) {
+            S value;
+            std::memcpy(&value, source + idx * sizeof(S), sizeof(S));
+            D result;
+            if constexpr (std::is_integral_v<D> && std::is_floating_point_v<S>) {
+                constexpr S min = static_cast<S>(std::numeric_limits<D>::min());
+                constexpr S max = static_cast<S>(std::numeric_limits<D>::max());
+                // Only cast values in range, the others are replaced below
+                S inRange = value > min && value < max ? value : S(0);
+                result = value != value ? D(0)
+                         : value <= min ? std::numeric_limits<D>::min()
+                         : value >= max ? std::numeric_limits<D>::max()
+                                        : static_cast<D>(inRange);
+            } else
+                result = castValue<S, D>(value);
+            std::memcpy(target + idx * sizeof(D), &result, sizeof(D));
+        }
+    }
+
+#ifdef H5COMPOSITES_X86_DISPATCH
+    /// The widest instruction set available on the running CPU
+    enum class SIMDLevel { None, AVX, AVX2, AVX512 };
+
+    SIMDLevel simdLevel() {
+        static const SIMDLevel level = [] {
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx512f"))
+                return SIMDLevel::AVX512;
+            if (__builtin_cpu_supports("avx2"))
+                return SIMDLevel::AVX2;
+            if (__builtin_cpu_supports("avx"))
+                return SIMDLevel::AVX;
+            return SIMDLevel::None;
+        }();
+        return level;
+    }
+
+    // Each kernel converts as many values as fit in whole vectors and returns how many that was,
+    // leaving the rest to the scalar loop. The AVX-512 conversions use the zero-masked forms with
+    // every lane set, as the unmasked ones start from an uninitialised vector which GCC warns
+    // about
+
+    __attribute__((target("avx"))) std::size_t doubleToFloatAVX(
+            const std::byte *source, std::byte *target, std::size_t n) {
+        std::size_t idx = 0;
+        for (; idx + 4 <= n; idx += 4)
+            _mm_storeu_ps(
+                    reinterpret_cast<float *>(target) + idx,
+                    _mm256_cvtpd_ps(
+                            _mm256_loadu_pd(reinterpret_cast<const double *>(source) + idx)));
+        return idx;
+    }
+
+    __attribute__((target("avx512f"))) std::size_t doubleToFloatAVX512(
+            const std::byte *source, std::byte *target, std::size_t n) {
+        std::size_t idx = 0;
+        for (; idx + 8 <= n; idx += 8)
+            _mm256_storeu_ps(
+                    reinterpret_cast<float *>(target) + idx,
+                    _mm512_maskz_cvtpd_ps(
+                            0xFF,
+                            _mm512_loadu_pd(reinterpret_cast<const double *>(source) + idx)));
+        return idx;
+    }
+
+    __attribute__((target("avx"))) std::size_t floatToDoubleAVX(
+            const std::byte *source, std::byte *target, std::size_t n) {
+        std::size_t idx = 0;
+        for (; idx + 4 <= n; idx += 4)
+            _mm256_storeu_pd(
+                    reinterpret_cast<double *>(target) + idx,
+                    _mm256_cvtps_pd(_mm_loadu_ps(reinterpret_cast<const float *>(source) + idx)));
+        return idx;
+    }
+
+    __attribute__((target("avx512f"))) std::size_t floatToDoubleAVX512(
+            const std::byte *source, std::byte *target, std::size_t n) {
+        std::size_t idx = 0;
+        for (; idx + 8 <= n; idx += 8)
+            _mm512_storeu_pd(
+                    reinterpret_cast<double *>(target) + idx,
+                    _mm512_maskz_cvtps_pd(
+                            0xFF,
+                            _mm256_loadu_ps(reinterpret_cast<const float *>(source) + idx)));
+        return idx;
+    }
+
+    __attribute__((target("avx2"))) std::size_t int64ToInt32AVX2(
+            const std::byte *source, std::byte *target, std::size_t n) {
+        const __m256i max = _mm256_set1_epi64x(std::numeric_limits<std::int32_t>::max());
+        const __m256i min = _mm256_set1_epi64x(std::numeric_limits<std::int32_t>::min());
+        // Gathers the low halves of the four values into the first 128 bits
+        const __m256i lowHalves = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+        std::size_t idx = 0;
+        for (; idx + 4 <= n; idx += 4) {
+            __m256i value = _mm256_loadu_si256(
+                    reinterpret_cast<const __m256i *>(source + idx * sizeof(std::int64_t)));
+            value = _mm256_blendv_epi8(value, max, _mm256_cmpgt_epi64(value, max));
+            value = _mm256_blendv_epi8(value, min, _mm256_cmpgt_epi64(min, value));
+            _mm_storeu_si128(
+                    reinterpret_cast<__m128i *>(target + idx * sizeof(std::int32_t)),
+                    _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(value, lowHalves)));
+        }
+        return idx;
+    }
+
+    __attribute__((target("avx512f"))) std::size_t int64ToInt32AVX512(
+            const std::byte *source, std::byte *target, std::size_t n) {
+        std::size_t idx = 0;
+        for (; idx + 8 <= n; idx += 8)
+            _mm256_storeu_si256(
+                    reinterpret_cast<__m256i *>(target + idx * sizeof(std::int32_t)),
+                    _mm512_maskz_cvtsepi64_epi32(
+                            0xFF, _mm512_loadu_si512(source + idx * sizeof(std::int64_t))));
+        return idx;
+    }
+
+    /// The shuffle reversing the bytes of each value of a given size within a 128 bit lane
+    template <std::size_t Size> constexpr std::array<std::int8_t, 32> swapMask() {
+        std::array<std::int8_t, 32> mask{};
+        for (std::size_t idx = 0; idx < mask.size(); ++idx) {
+            std::size_t byte = idx % 16;
+            mask[idx] = byte / Size * Size + Size - 1 - byte % Size;
+        }
+        return mask;
+    }
+
+    template <std::size_t Size>
+    __attribute__((target("avx2"))) std::size_t swapAVX2(
+            const std::byte *source, std::byte *target, std::size_t n) {
+        static constexpr std::array<std::int8_t, 32> maskBytes = swapMask<Size>();
+        const __m256i mask =
+                _mm256_loadu_si256(reinterpret_cast<const __m256i *>(maskBytes.data()));
+        constexpr std::size_t perVector = 32 / Size;
+        std::size_t idx = 0;
+        for (; idx + perVector <= n; idx += perVector)
+            _mm256_storeu_si256(
+                    reinterpret_cast<__m256i *>(target + idx * Size),
+                    _mm256_shuffle_epi8(
+                            _mm256_loadu_si256(
+                                    reinterpret_cast<const __m256i *>(source + idx * Size)),
+                            mask));
+        return idx;
+    }
+#endif
+
+    /// Convert values from first up to n, one at a time
+    template <typename S, typename D>
+    void convertScalar(
+            const std::byte *source, std::byte *target, std::size_t first, std::size_t n) {
+        for (std::size_t idx = first; idx < n; ++idx) {
+            S value;
+            std::memcpy(&value, source + idx * sizeof(S), sizeof(S));
+            D result = castValue<S, D>(value);
+            std::memcpy(target + idx * sizeof(D), &result, sizeof(D));
+        }
+    }
+
+    // Explicit kernels for the most common conversions when writing: between floating point
+    // widths and from 64 to 32 bit integers. The compiler does not vectorise the saturation in
+    // the last of these by itself
+    template <>
+    void convertContiguous<double, float>(
+            const std::byte *source, std::byte *target, std::size_t n) {
+        std::size_t idx = 0;
+#ifdef H5COMPOSITES_X86_DISPATCH
+        switch (simdLevel()) {
+        case SIMDLevel::AVX512:
+            idx = doubleToFloatAVX512(source, target, n);
+            break;
+        case SIMDLevel::AVX2:
+        case SIMDLevel::AVX:
+            idx = doubleToFloatAVX(source, target, n);
+            break;
+        default:
+            break;
+        }
+#endif
+        convertScalar<double, float>(source, target, idx, n);
+    }
+
+    template <>
+    void convertContiguous<float, double>(
+            const std::byte *source, std::byte *target, std::size_t n) {
+        std::size_t idx = 0;
+#ifdef H5COMPOSITES_X86_DISPATCH
+        switch (simdLevel()) {
+        case SIMDLevel::AVX512:
+            idx = floatToDoubleAVX512(source, target, n);
+            break;
+        case SIMDLevel::AVX2:
+        case SIMDLevel::AVX:
+            idx = floatToDoubleAVX(source, target, n);
+            break;
+        default:
+            break;
+        }
+#endif
+        convertScalar<float, double>(source, target, idx, n);
+    }
+
+    template <>
+    void convertContiguous<std::int64_t, std::int32_t>(
+            const std::byte *source, std::byte *target, std::size_t n) {
+        std::size_t idx = 0;
+#ifdef H5COMPOSITES_X86_DISPATCH
+        switch (simdLevel()) {
+        case SIMDLevel::AVX512:
+            idx = int64ToInt32AVX512(source, target, n);
+            break;
+        case SIMDLevel::AVX2:
+            idx = int64ToInt32AVX2(source, target, n);
+            break;
+        default:
+            break;
+        }
+#endif
+        convertScalar<std::int64_t, std::int32_t>(source, target, idx, n);
+    }
+
+    template <typename S, typename D>
+    void convertStrided(
+            const std::byte *source, std::size_t sourceStride, std::byte *target,
+            std::size_t targetStride, std::size_t n) {
+        if (sourceStride == sizeof(S) && targetStride == sizeof(D))
+            // Plain arrays of numbers, rather than members of a compound
+            return convertContiguous<S, D>(source, target, n);
+        // Members of a compound. Gather them into contiguous scratch so that the vector kernels
+        // can convert them, then scatter the results
+        alignas(64) std::byte gathered[tileSize * sizeof(S)];
+        alignas(64) std::byte converted[tileSize * sizeof(D)];
+        for (std::size_t first = 0; first < n; first += tileSize) {
+            std::size_t nTile = std::min(tileSize, n - first);
+            const std::byte *sourceTile = source + first * sourceStride;
+            std::byte *targetTile = target + first * targetStride;
+            for (std::size_t idx = 0; idx < nTile; ++idx)
+                std::memcpy(gathered + idx * sizeof(S), sourceTile + idx * sourceStride, sizeof(S));
+            convertContiguous<S, D>(gathered, converted, nTile);
+            for (std::size_t idx = 0; idx < nTile; ++idx)
+                std::memcpy(
+                        targetTile + idx * targetStride, converted + idx * sizeof(D), sizeof(D));
+        }
+    }
+
+    /// Copy n values between strided locations, reversing the byte order of each
+    template <std::size_t Size>
+    void swapStrided(
+            const std::byte *source, std::size_t sourceStride, std::byte *target,
+            std::size_t targetStride, std::size_t n) {
+        std::size_t first = 0;
+#ifdef H5COMPOSITES_X86_DISPATCH
+        if constexpr (Size > 1)
+            if (sourceStride == Size && targetStride == Size && simdLevel() >= SIMDLevel::AVX2)
+                // Packed values, so a byte shuffle swaps a whole vector at once
+                first = swapAVX2<Size>(source, target, n);
+#endif
+        for (std::size_t idx = first; idx < n; ++idx) {
+            const std::byte *from = source + idx * sourceStride;
+            std::byte *to = target + idx * targetStride;
+            for (std::size_t byte = 0; byte < Size; ++byte)
+                to[byte] = from[Size - 1 - byte];
+        }
+    }
+
+    /// The byte swapping kernel for values of a given size
+    MemberwiseConverter::Kernel swapKernel(std::size_t size) {
+        switch (size) {
+        case 1:
+            return &swapStrided<1>;
+        case 2:
+            return &swapStrided<2>;
+        case 4:
+            return &swapStrided<4>;
+        case 8:
+            return &swapStrided<8>;
+        default:
+            return nullptr;
+        }
+    }
+
+    template <std::size_t... Is>
+    constexpr std::array<MemberwiseConverter::Kernel, sizeof...(Is)> makeKernels(
+            std::index_sequence<Is...>) {
+        return {&convertStrided<
+                std::tuple_element_t<Is / nNumeric, NumericTypes>,
+                std::tuple_element_t<Is % nNumeric, NumericTypes>>...};
+    }
+
+    /// Kernels for every pair of numeric types, indexed by source * nNumeric + target
+    constexpr auto kernels = makeKernels(std::make_index_sequence<nNumeric * nNumeric>());
+
+} // namespace
+
+namespace H5Composites {
+    std::unique_ptr<MemberwiseConverter> MemberwiseConverter::create(
+            const H5::DataType &source, const H5::DataType &target) {
+        std::unique_ptr<MemberwiseConverter> converter(
+                new MemberwiseConverter(source.getSize(), target.getSize()));
+        if (!converter->addSteps(source, 0, target, 0))
+            return nullptr;
+        converter->finalise();
+        return converter;
+    }
+
+    void MemberwiseConverter::operator()(const void *source, void *target, std::size_t n) const {
+        const std::byte *sourceBytes = static_cast<const std::byte *>(source);
+        std::byte *targetBytes = static_cast<std::byte *>(target);
+        for (std::size_t first = 0; first < n; first += tileSize) {
+            std::size_t nTile = std::min(tileSize, n - first);
+            const std::byte *sourceTile = sourceBytes + first * m_sourceSize;
+            std::byte *targetTile = targetBytes + first * m_targetSize;
+            for (const Step &step : m_steps) {
+                if (step.kernel)
+                    step.kernel(
+                            sourceTile + step.sourceOffset, m_sourceSize,
+                            targetTile + step.targetOffset, m_targetSize, nTile);
+                else if (step.zero)
+                    for (std::size_t idx = 0; idx < nTile; ++idx)
+                        std::memset(targetTile + idx * m_targetSize + step.targetOffset, 0,
+                                    step.size);
+                else
+                    for (std::size_t idx = 0; idx < nTile; ++idx)
+                        std::memcpy(
+                                targetTile + idx * m_targetSize + step.targetOffset,
+                                sourceTile + idx * m_sourceSize + step.sourceOffset, step.size);
+            }
+        }
+    }
+
+    MemberwiseConverter::MemberwiseConverter(std::size_t sourceSize, std::size_t targetSize)
+            : m_sourceSize(sourceSize), m_targetSize(targetSize) {}
+
+    bool MemberwiseConverter::addSteps(
+            const H5::DataType &source, std::size_t sourceOffset, const H5::DataType &target,
+            std::size_t targetOffset) {
+        if (source == target) {
+            if (!isPlainData(source))
+                return false;
+            m_steps.push_back(Step{sourceOffset, targetOffset, target.getSize()});
+            return true;
+        }
+        if (std::optional<NumericInfo> targetInfo = numericInfo(target)) {
+            std::optional<NumericInfo> sourceInfo = numericInfo(source);
+            if (!sourceInfo)
+                return false;
+            Kernel kernel = nullptr;
+            if (!sourceInfo->swapped && !targetInfo->swapped)
+                kernel = kernels[sourceInfo->index * nNumeric + targetInfo->index];
+            else if (sourceInfo->index == targetInfo->index)
+                // Only the byte order differs
+                kernel = swapKernel(target.getSize());
+            if (!kernel)
+                // Changing the type and the byte order at once is left to H5
+                return false;
+            m_steps.push_back(Step{sourceOffset, targetOffset, target.getSize(), kernel});
+            return true;
+        }
+        H5T_class_t cls = target.getClass();
+        if (cls != source.getClass())
+            return false;
+        if (cls == H5T_COMPOUND) {
+            H5::CompType sourceComp(source.getId());
+            H5::CompType targetComp(target.getId());
+            for (int idx = 0; idx < targetComp.getNmembers(); ++idx) {
+                std::string name = targetComp.getMemberName(idx);
+                // Use the C API as the C++ one throws for missing members
+                int sourceIdx = H5Tget_member_index(sourceComp.getId(), name.c_str());
+                if (sourceIdx < 0)
+                    // Only in the target, this is zeroed when the gaps are filled
+                    continue;
+                if (!addSteps(
+                            sourceComp.getMemberDataType(sourceIdx),
+                            sourceOffset + sourceComp.getMemberOffset(sourceIdx),
+                            targetComp.getMemberDataType(idx),
+                            targetOffset + targetComp.getMemberOffset(idx)))
+                    return false;
+            }
+            return true;
+        }
+        if (cls == H5T_ARRAY) {
+            H5::ArrayType sourceArr(source.getId());
+            H5::ArrayType targetArr(target.getId());
+            int rank = targetArr.getArrayNDims();
+            if (sourceArr.getArrayNDims() != rank)
+                return false;
+            std::vector<hsize_t> sourceDims(rank);
+            std::vector<hsize_t> targetDims(rank);
+            sourceArr.getArrayDims(sourceDims.data());
+            targetArr.getArrayDims(targetDims.data());
+            if (sourceDims != targetDims)
+                return false;
+            H5::DataType sourceSuper = sourceArr.getSuper();
+            H5::DataType targetSuper = targetArr.getSuper();
+            std::size_t nElements = target.getSize() / targetSuper.getSize();
+            for (std::size_t idx = 0; idx < nElements; ++idx)
+                if (!addSteps(
+                            sourceSuper, sourceOffset + idx * sourceSuper.getSize(), targetSuper,
+                            targetOffset + idx * targetSuper.getSize()))
+                    return false;
+            return true;
+        }
+        return false;
+    }
+
+    void MemberwiseConverter::finalise() {
+        std::sort(m_steps.begin(), m_steps.end(), [](const Step &lhs, const Step &rhs) {
+            return lhs.targetOffset < rhs.targetOffset;
+        });
+        std::vector<Step> steps;
+        std::size_t position = 0;
+        for (const Step &step : m_steps) {
+            if (step.targetOffset > position)
+                steps.push_back(Step{0, position, step.targetOffset - position, nullptr, true});
+            Step *previous = steps.empty() ? nullptr : &steps.back();
+            if (previous && !previous->kernel && !previous->zero && !step.kernel &&
+                previous->sourceOffset + previous->size == step.sourceOffset &&
+                previous->targetOffset + previous->size == step.targetOffset)
+                // Neighbouring copies can be done at once
+                previous->size += step.size;
+            else
+                steps.push_back(step);
+            position = step.targetOffset + step.size;
+        }
+        if (position < m_targetSize)
+            steps.push_back(Step{0, position, m_targetSize - position, nullptr, true});
+        m_steps = std::move(steps);
+    }
+} // namespace H5Composites
@@ -0,0 +1,242 @@
+#include "H5Composites/ParallelScan.hxx"
+#include "H5Composites/DTypeConversion.hxx"
+#include "H5Composites/H5BufferView.hxx"
+#include "H5Composites/Reader.hxx"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+namespace H5Composites {
+    ParallelScan::ParallelScan(
+            const H5::DataType &dtype, const H5::DataSet &dataset, std::size_t nWorkers,
+            std::size_t blockSize, std::size_t nBuffers)
+            : m_dtype(dtype), m_dataset(dataset), m_readDType(dtype), m_nWorkers(nWorkers),
+              m_caches(nWorkers ? nWorkers : 1),
+              m_metrics(std::make_unique<IOMetricsRecorder>(IOMetricsRecorder::Source::Reader)) {
+        if (blockSize == 0)
+            throw std::invalid_argument("The block size must be above 0");
+        if (nWorkers) {
+            hbool_t threadsafe = false;
+            H5is_library_threadsafe(&threadsafe);
+            if (!threadsafe)
+                throw std::runtime_error("Parallel scans require a thread-safe H5 library");
+        }
+        H5::DSetCreatPropList propList = m_dataset.getCreatePlist();
+        hsize_t chunkSize = 0;
+        if (propList.getLayout() == H5D_CHUNKED)
+            propList.getChunk(1, &chunkSize);
+        if (blockSize == SIZE_MAX)
+            blockSize = chunkSize ? chunkSize : Reader::defaultCacheSize;
+        else if (chunkSize)
+            // Split on chunk boundaries so that each chunk is only decoded once
+            blockSize = (blockSize + chunkSize - 1) / chunkSize * chunkSize;
+        m_blockSize = blockSize;
+        m_nBuffers = nBuffers == SIZE_MAX ? std::max<std::size_t>(2 * nWorkers, 1) : nBuffers;
+        if (m_nBuffers == 0)
+            throw std::invalid_argument("At least one buffer is required");
+        hsize_t dims;
+        m_dataset.getSpace().getSimpleExtentDims(&dims);
+        m_nRows = dims;
+        // If the conversion can be done outside of H5 leave it to the workers, otherwise let H5
+        // convert while reading rather than do it in a second serialised call
+        H5::DataType fileDType = m_dataset.getDataType();
+        if (fileDType != m_dtype &&
+            ConversionPlanCache::instance().get(fileDType, m_dtype)->memberwise)
+            m_readDType = fileDType;
+    }
+
+    ParallelScan::~ParallelScan() = default;
+
+    void ParallelScan::forEachBlock(const BlockCallback &callback) {
+        std::size_t nBlocks = (m_nRows + m_blockSize - 1) / m_blockSize;
+        auto makeBlock = [this](std::size_t idx) {
+            std::size_t first = idx * m_blockSize;
+            return Block{first, std::min(m_blockSize, m_nRows - first), {}};
+        };
+        if (m_nWorkers == 0) {
+            if (m_buffers.empty())
+                m_buffers.push_back(makeBuffer());
+            for (std::size_t idx = 0; idx < nBlocks; ++idx) {
+                Block block = makeBlock(idx);
+                block.buffer = std::move(m_buffers.back());
+                m_buffers.pop_back();
+                try {
+                    read(block);
+                    m_buffers.push_back(process(0, std::move(block), callback));
+                } catch (...) {
+                    m_buffers.push_back(std::move(block.buffer));
+                    throw;
+                }
+            }
+            return;
+        }
+
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::deque<Block> ready;
+        // The number of buffers either waiting to be processed or being processed
+        std::size_t nInFlight = 0;
+        bool readDone = false;
+        std::exception_ptr error;
+
+        auto readLoop = [&]() {
+            for (std::size_t idx = 0; idx < nBlocks; ++idx) {
+                Block block = makeBlock(idx);
+                {
+                    std::unique_lock lock(mutex);
+                    cv.wait(lock, [&] { return error || nInFlight < m_nBuffers; });
+                    if (error)
+                        break;
+                    ++nInFlight;
+                    if (!m_buffers.empty()) {
+                        block.buffer = std::move(m_buffers.back());
+                        m_buffers.pop_back();
+                    }
+                }
+                try {
+                    if (!block.buffer)
+                        block.buffer = makeBuffer();
+                    read(block);
+                } catch (...) {
+                    std::lock_guard lock(mutex);
+                    error = std::current_exception();
+                    m_buffers.push_back(std::move(block.buffer));
+                    break;
+                }
+                {
+                    std::lock_guard lock(mutex);
+                    ready.push_back(std::move(block));
+                }
+                cv.notify_all();
+            }
+            {
+                std::lock_guard lock(mutex);
+                readDone = true;
+            }
+            cv.notify_all();
+        };
+
+        auto workLoop = [&](std::size_t worker) {
+            while (true) {
+                Block block;
+                {
+                    std::unique_lock lock(mutex);
+                    cv.wait(lock, [&] { return error || !ready.empty() || readDone; });
+                    if (error || ready.empty())
+                        return;
+                    block = std::move(ready.front());
+                    ready.pop_front();
+                }
+                SmartBuffer buffer;
+                try {
+                    buffer = process(worker, std::move(block), callback);
+                } catch (...) {
+                    std::lock_guard lock(mutex);
+                    if (!error)
+                        error = std::current_exception();
+                    m_buffers.push_back(std::move(block.buffer));
+                    --nInFlight;
+                    cv.notify_all();
+                    return;
+                }
+                {
+                    std::lock_guard lock(mutex);
+                    m_buffers.push_back(std::move(buffer));
+                    --nInFlight;
+                }
+                cv.notify_all();
+            }
+        };
+
+        std::vector<std::thread> threads;
+        threads.emplace_back(readLoop);
+        for (std::size_t idx = 0; idx < m_nWorkers; ++idx)
+            threads.emplace_back(workLoop, idx);
+        for (std::thread &thread : threads)
+            thread.join();
+        // Free the vlen data from anything that was read but not processed
+        for (Block &block : ready) {
+            reclaim(m_readDType, block.buffer.get(), block.nRows);
+            m_buffers.push_back(std::move(block.buffer));
+        }
+        if (error)
+            std::rethrow_exception(error);
+    }
+
+    void ParallelScan::forEach(const RowCallback &callback) {
+        forEachBlock([this, &callback](
+                             std::size_t worker, std::size_t first, const H5BufferConstView &rows,
+                             std::size_t n) {
+            const std::byte *data = static_cast<const std::byte *>(rows.get());
+            for (std::size_t idx = 0; idx < n; ++idx)
+                callback(
+                        worker, first + idx,
+                        H5BufferConstView(data + idx * rows.footprint(), m_dtype));
+        });
+    }
+
+    void ParallelScan::read(Block &block) {
+        hsize_t nRows = block.nRows;
+        hsize_t offset = block.first;
+        m_metrics->addBlock(nRows, nRows * m_dtype.getSize());
+        H5::DataSpace slabSpace(1, &nRows);
+        H5::DataSpace sourceSpace = m_dataset.getSpace();
+        sourceSpace.selectHyperslab(H5S_SELECT_SET, &nRows, &offset);
+        IOMetricsRecorder::Scope timer(*m_metrics, IOMetricsRecorder::Timer::IO);
+        m_dataset.read(block.buffer.get(), m_readDType, slabSpace, sourceSpace);
+    }
+
+    SmartBuffer ParallelScan::process(
+            std::size_t worker, Block &&block, const BlockCallback &callback) {
+        if (m_readDType == m_dtype) {
+            // Already in the right type so the callback can use the block directly
+            try {
+                callback(
+                        worker, block.first, H5BufferConstView(block.buffer.get(), m_dtype),
+                        block.nRows);
+            } catch (...) {
+                reclaim(m_dtype, block.buffer.get(), block.nRows);
+                throw;
+            }
+            reclaim(m_dtype, block.buffer.get(), block.nRows);
+            return std::move(block.buffer);
+        }
+        SmartBuffer &cache = m_caches.at(worker);
+        if (!cache)
+            cache = SmartBuffer(m_blockSize * m_dtype.getSize(), BufferAllocator::cache());
+        try {
+            IOMetricsRecorder::Scope timer(*m_metrics, IOMetricsRecorder::Timer::Conversion);
+            convert(H5BufferConstView(block.buffer.get(), m_readDType),
+                    H5BufferView(cache.get(), m_dtype), block.nRows);
+        } catch (...) {
+            reclaim(m_readDType, block.buffer.get(), block.nRows);
+            throw;
+        }
+        reclaim(m_readDType, block.buffer.get(), block.nRows);
+        try {
+            callback(worker, block.first, H5BufferConstView(cache.get(), m_dtype), block.nRows);
+        } catch (...) {
+            reclaim(m_dtype, cache.get(), block.nRows);
+            throw;
+        }
+        reclaim(m_dtype, cache.get(), block.nRows);
+        return std::move(block.buffer);
+    }
+
+    void ParallelScan::reclaim(const H5::DataType &dtype, void *buffer, std::size_t nRows) {
+        if (nRows == 0)
+            return;
+        hsize_t size = nRows;
+        IOMetricsRecorder::Scope timer(*m_metrics, IOMetricsRecorder::Timer::Reclaim);
+        H5Dvlen_reclaim(dtype.getId(), H5::DataSpace(1, &size).getId(), H5P_DEFAULT, buffer);
+    }
+
+    SmartBuffer ParallelScan::makeBuffer() {
+        return SmartBuffer(m_blockSize * m_readDType.getSize(), BufferAllocator::cache());
+    }
+} // namespace H5Composites
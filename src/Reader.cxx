@@ -1,53 +1,638 @@
 #include "H5Composites/Reader.hxx"
+#include "H5Composites/CompDTypeUtils.hxx"
+#include "H5Composites/DTypeConversion.hxx"
+#include "H5Composites/DTypeIterator.hxx"
+#include "H5Composites/DataSetIndex.hxx"
+#include "H5Composites/MemberwiseConverter.hxx"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+#if __has_include(<sys/mman.h>)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#define H5COMPOSITES_HAS_MMAP
+#endif
+
+namespace {
+    using H5Composites::IOMetricsRecorder;
+
+    /// The most memory used per thread to stage rows before converting them
+    constexpr std::size_t maxStagingBytes = 1 << 20;
+
+    /**
+     * @brief Read a block of rows, converting them with a MemberwiseConverter where possible
+     * @param dataset The dataset to read from
+     * @param fileDType The data type of the dataset, this should be kept between calls
+     * @param target The buffer to read into
+     * @param dtype The data type to read
+     * @param offset The first row to read
+     * @param nRows The number of rows to read
+     * @param transfer The transfer properties, used if the read goes through H5
+     * @param metrics Records the work done
+     *
+     * Letting H5 convert between compound types is slow. If the conversion is one that the
+     * MemberwiseConverter can handle then the members that are needed are read in their file
+     * types and converted here instead, a tile at a time so that the staging memory stays small.
+     */
+    void readRows(
+            const H5::DataSet &dataset, const H5::DataType &fileDType, void *target,
+            const H5::DataType &dtype, hsize_t offset, hsize_t nRows,
+            const H5::DSetMemXferPropList &transfer, IOMetricsRecorder &metrics) {
+        metrics.addBlock(nRows, nRows * dtype.getSize());
+        H5::DataSpace slabSpace(1, &nRows);
+        H5::DataSpace sourceSpace = dataset.getSpace();
+        sourceSpace.selectHyperslab(H5S_SELECT_SET, &nRows, &offset);
+        std::shared_ptr<const H5Composites::ConversionPlan> plan;
+        if (fileDType != dtype)
+            plan = H5Composites::ConversionPlanCache::instance().get(fileDType, dtype);
+        if (!plan || !plan->readMemberwise) {
+            IOMetricsRecorder::Scope timer(metrics, IOMetricsRecorder::Timer::IO);
+            dataset.read(target, dtype, slabSpace, sourceSpace, transfer);
+            return;
+        }
+        const H5::DataType &stagingDType = plan->readDType;
+        std::size_t stagingRows =
+                std::max<std::size_t>(maxStagingBytes / stagingDType.getSize(), 1);
+        thread_local H5Composites::SmartBuffer staging;
+        thread_local std::size_t capacity = 0;
+        std::size_t size = std::min<std::size_t>(nRows, stagingRows) * stagingDType.getSize();
+        if (capacity < size) {
+            staging = H5Composites::SmartBuffer(size, H5Composites::BufferAllocator::cache());
+            capacity = size;
+        }
+        std::byte *targetBytes = static_cast<std::byte *>(target);
+        for (hsize_t done = 0; done < nRows;) {
+            hsize_t nTile = std::min<hsize_t>(nRows - done, stagingRows);
+            hsize_t tileOffset = offset + done;
+            H5::DataSpace tileSpace(1, &nTile);
+            sourceSpace.selectHyperslab(H5S_SELECT_SET, &nTile, &tileOffset);
+            {
+                IOMetricsRecorder::Scope timer(metrics, IOMetricsRecorder::Timer::IO);
+                dataset.read(staging.get(), stagingDType, tileSpace, sourceSpace);
+            }
+            IOMetricsRecorder::Scope timer(metrics, IOMetricsRecorder::Timer::Conversion);
+            (*plan->readMemberwise)(staging.get(), targetBytes + done * dtype.getSize(), nTile);
+            done += nTile;
+        }
+    }
+} // namespace
 
 namespace H5Composites {
-    Reader::Reader(const H5::DataType &dtype, const H5::DataSet &dataset, std::size_t cacheSize)
-            : m_dtype(dtype), m_dataset(dataset) {
-        if (cacheSize == static_cast<std::size_t>(-1)) {
-            hsize_t chunkSize;
-            m_dataset.getCreatePlist().getChunk(1, &chunkSize);
-            cacheSize = chunkSize;
+    /// @brief Reads blocks of a dataset in a background thread
+    ///
+    /// The reader hands back each buffer it has finished with (after reclaiming any vlen data) so
+    /// that the number of buffers in existence is fixed. If the reader uses a vlen arena then
+    /// each buffer carries its own.
+    class Reader::Prefetcher {
+    public:
+        struct Block {
+            SmartBuffer buffer;
+            std::unique_ptr<VLenArena> arena;
+            hsize_t nRows;
+        };
+
+        Prefetcher(
+                const H5::DataType &dtype, const H5::DataType &fileDType,
+                const H5::DataSet &dataset, std::size_t cacheSize, hsize_t offset,
+                hsize_t nRemaining, std::size_t nBuffers, std::size_t arenaBlockSize,
+                IOMetricsRecorder &metrics)
+                : m_dtype(dtype), m_fileDType(fileDType), m_dataset(dataset),
+                  m_cacheSize(cacheSize), m_offset(offset), m_nRemaining(nRemaining),
+                  m_metrics(metrics) {
+            for (std::size_t idx = 0; idx < nBuffers; ++idx)
+                m_free.push_back(Block{
+                        SmartBuffer(m_cacheSize * m_dtype.getSize(), BufferAllocator::cache()),
+                        arenaBlockSize ? std::make_unique<VLenArena>(arenaBlockSize) : nullptr,
+                        0});
+            m_thread = std::thread(&Prefetcher::run, this);
+        }
+
+        ~Prefetcher() {
+            {
+                std::lock_guard lock(m_mutex);
+                m_stop = true;
+            }
+            m_cv.notify_all();
+            m_thread.join();
+            IOMetricsRecorder::Scope timer(m_metrics, IOMetricsRecorder::Timer::Reclaim);
+            for (Block &block : m_filled)
+                if (!block.arena)
+                    H5Dvlen_reclaim(
+                            m_dtype.getId(), H5::DataSpace(1, &block.nRows).getId(),
+                            H5P_DEFAULT, block.buffer.get());
+        }
+
+        /// @brief Get the next filled block, waiting for it if necessary
+        ///
+        /// Returns std::nullopt when the dataset is exhausted
+        std::optional<Block> pop() {
+            std::unique_lock lock(m_mutex);
+            m_cv.wait(lock, [this] { return !m_filled.empty() || m_done || m_error; });
+            if (m_error)
+                std::rethrow_exception(m_error);
+            if (m_filled.empty())
+                return std::nullopt;
+            Block block = std::move(m_filled.front());
+            m_filled.pop_front();
+            return block;
+        }
+
+        /// @brief Return a buffer whose vlen data has already been reclaimed, with its arena
+        void recycle(SmartBuffer &&buffer, std::unique_ptr<VLenArena> &&arena) {
+            {
+                std::lock_guard lock(m_mutex);
+                m_free.push_back(Block{std::move(buffer), std::move(arena), 0});
+            }
+            m_cv.notify_all();
+        }
+
+    private:
+        void run() {
+            try {
+                while (true) {
+                    Block block;
+                    {
+                        std::unique_lock lock(m_mutex);
+                        m_cv.wait(lock, [this] { return m_stop || !m_free.empty(); });
+                        if (m_stop)
+                            return;
+                        if (m_nRemaining == 0) {
+                            m_done = true;
+                            break;
+                        }
+                        block = std::move(m_free.front());
+                        m_free.pop_front();
+                    }
+                    // Only this thread touches the offsets so the read can happen unlocked. H5
+                    // itself serialises this against anything happening in other threads
+                    hsize_t slabSize = std::min<hsize_t>(m_cacheSize, m_nRemaining);
+                    readRows(
+                            m_dataset, m_fileDType, block.buffer.get(), m_dtype, m_offset,
+                            slabSize,
+                            block.arena ? block.arena->transferPropList()
+                                        : H5::DSetMemXferPropList::DEFAULT,
+                            m_metrics);
+                    m_offset += slabSize;
+                    m_nRemaining -= slabSize;
+                    block.nRows = slabSize;
+                    {
+                        std::lock_guard lock(m_mutex);
+                        m_filled.push_back(std::move(block));
+                    }
+                    m_cv.notify_all();
+                }
+            } catch (...) {
+                std::lock_guard lock(m_mutex);
+                m_error = std::current_exception();
+            }
+            m_cv.notify_all();
+        }
+
+        H5::DataType m_dtype;
+        H5::DataType m_fileDType;
+        H5::DataSet m_dataset;
+        std::size_t m_cacheSize;
+        hsize_t m_offset;
+        hsize_t m_nRemaining;
+        IOMetricsRecorder &m_metrics;
+        std::mutex m_mutex;
+        std::condition_variable m_cv;
+        std::deque<Block> m_free;
+        std::deque<Block> m_filled;
+        bool m_stop{false};
+        bool m_done{false};
+        std::exception_ptr m_error;
+        std::thread m_thread;
+    };
+
+    /// @brief A read-only mapping of the part of a file holding a contiguous dataset
+    class Reader::MemoryMap {
+    public:
+        /// @brief Map a dataset if possible
+        /// @return The mapping or nullptr if the dataset cannot be read this way
+        static std::unique_ptr<MemoryMap> create(
+                const H5::DataSet &dataset, const H5::DataType &fileDType,
+                const H5::DataType &dtype, hsize_t nRows, AccessPattern pattern) {
+#ifdef H5COMPOSITES_HAS_MMAP
+            if (nRows == 0 || dtype != fileDType || H5Tdetect_class(dtype.getId(), H5T_VLEN) > 0)
+                return nullptr;
+            // Variable length strings are not a separate class so check them separately
+            for (DTypeIterator itr(dtype); itr.elemType() != DTypeIterator::ElemType::End; ++itr)
+                if (itr.elemType() == DTypeIterator::ElemType::String && itr->isVariableStr())
+                    return nullptr;
+            H5::DSetCreatPropList propList = dataset.getCreatePlist();
+            if (propList.getLayout() != H5D_CONTIGUOUS || propList.getNfilters() != 0)
+                return nullptr;
+            haddr_t address = H5Dget_offset(dataset.getId());
+            if (address == HADDR_UNDEF)
+                return nullptr;
+            hid_t fileID = H5Iget_file_id(dataset.getId());
+            hid_t accessPropList = H5Fget_access_plist(fileID);
+            bool defaultDriver = H5Pget_driver(accessPropList) == H5FD_SEC2;
+            H5Pclose(accessPropList);
+            unsigned int intent = 0;
+            H5Fget_intent(fileID, &intent);
+            // Make sure anything written through this file handle has reached the disk
+            if (defaultDriver && (intent & H5F_ACC_RDWR))
+                H5Fflush(fileID, H5F_SCOPE_LOCAL);
+            H5Fclose(fileID);
+            if (!defaultDriver)
+                return nullptr;
+            int fd = open(dataset.getFileName().c_str(), O_RDONLY);
+            if (fd < 0)
+                return nullptr;
+            // Mappings have to start on a page boundary
+            std::size_t pageSize = sysconf(_SC_PAGESIZE);
+            std::size_t start = address - address % pageSize;
+            std::size_t length = address - start + nRows * dtype.getSize();
+            void *base = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, start);
+            // The mapping holds its own reference to the file
+            close(fd);
+            if (base == MAP_FAILED)
+                return nullptr;
+            std::unique_ptr<MemoryMap> map(new MemoryMap(
+                    base, length, static_cast<const std::byte *>(base) + (address - start),
+                    dtype.getSize(), pageSize));
+            switch (pattern) {
+            case AccessPattern::Sequential:
+                madvise(base, length, MADV_SEQUENTIAL);
+                break;
+            case AccessPattern::Random:
+                madvise(base, length, MADV_RANDOM);
+                break;
+            case AccessPattern::Resident:
+                madvise(base, length, MADV_WILLNEED);
+                break;
+            }
+            return map;
+#else
+            return nullptr;
+#endif
+        }
+
+        ~MemoryMap() {
+#ifdef H5COMPOSITES_HAS_MMAP
+            munmap(m_base, m_length);
+#endif
+        }
+
+        /// The start of a row
+        const std::byte *row(std::size_t idx) const { return m_data + idx * m_rowSize; }
+
+        /// @brief Ask the kernel to start reading a range of rows
+        void willNeed(std::size_t first, std::size_t n) const {
+#ifdef H5COMPOSITES_HAS_MMAP
+            if (n == 0)
+                return;
+            std::uintptr_t begin = reinterpret_cast<std::uintptr_t>(row(first));
+            std::uintptr_t end = reinterpret_cast<std::uintptr_t>(row(first + n));
+            begin -= begin % m_pageSize;
+            madvise(reinterpret_cast<void *>(begin), end - begin, MADV_WILLNEED);
+#endif
         }
+
+    private:
+        MemoryMap(
+                void *base, std::size_t length, const std::byte *data, std::size_t rowSize,
+                std::size_t pageSize)
+                : m_base(base), m_length(length), m_data(data), m_rowSize(rowSize),
+                  m_pageSize(pageSize) {}
+
+        void *m_base;
+        std::size_t m_length;
+        const std::byte *m_data;
+        std::size_t m_rowSize;
+        std::size_t m_pageSize;
+    };
+
+    Reader::Reader(const H5::DataType &dtype, const H5::DataSet &dataset, std::size_t cacheSize)
+            : m_dtype(dtype), m_fileDType(dataset.getDataType()), m_objectSize(dtype.getSize()),
+              m_dataset(dataset),
+              m_metrics(std::make_unique<IOMetricsRecorder>(IOMetricsRecorder::Source::Reader)) {
+        H5::DSetCreatPropList propList = m_dataset.getCreatePlist();
+        hsize_t chunkSize = 0;
+        if (propList.getLayout() == H5D_CHUNKED)
+            propList.getChunk(1, &chunkSize);
+        if (cacheSize == static_cast<std::size_t>(-1))
+            cacheSize = chunkSize ? chunkSize : defaultCacheSize;
         m_cacheSize = cacheSize;
-        m_buffer.resize(m_cacheSize * m_dtype.getSize());
-        // Set the cache position so that the first call to next triggers a read
-        m_cachePosition = m_cacheSize;
+        m_buffer = SmartBuffer(m_cacheSize * m_objectSize, BufferAllocator::cache());
         hsize_t dims;
         m_dataset.getSpace().getSimpleExtentDims(&dims);
         m_nRemainingInDS = dims;
+        m_nRows = dims;
+        // Random access blocks are a whole number of chunks so each read decodes full chunks
+        if (chunkSize)
+            m_blockRows = std::max<std::size_t>(m_cacheSize / chunkSize, 1) * chunkSize;
+        else
+            m_blockRows = std::max<std::size_t>(m_cacheSize, 1);
     }
 
     Reader::Reader(const H5::DataSet &dataset, std::size_t cacheSize)
             : Reader(dataset.getDataType(), dataset, cacheSize) {}
 
+    Reader::Reader(
+            const H5::DataSet &dataset, const std::vector<std::string> &members,
+            std::size_t cacheSize)
+            : Reader(projectCompoundDType(dataset.getCompType(), members), dataset, cacheSize) {}
+
     Reader::~Reader() {
+        // Stop the background thread before touching the cache
+        m_prefetcher.reset();
         // Make sure we free any vlen memory
+        reclaimCache();
+        while (!m_blocks.empty())
+            evictBlock();
+    }
+
+    void Reader::useVLenArena(std::size_t blockSize) {
+        if (m_prefetcher)
+            throw std::logic_error("The vlen arena must be set before prefetching");
         if (m_nInCache)
-            H5Dvlen_reclaim(
-                    m_dtype.getId(), H5::DataSpace(1, &m_nInCache).getId(), H5P_DEFAULT,
-                    m_buffer.get());
+            throw std::logic_error("The vlen arena must be set before reading");
+        m_arena = std::make_unique<VLenArena>(blockSize);
+    }
+
+    void Reader::startPrefetching(std::size_t nBuffers) {
+        if (m_prefetcher)
+            throw std::logic_error("Reader is already prefetching");
+        if (m_map)
+            throw std::logic_error("A memory mapped reader cannot prefetch");
+        if (nBuffers < 2)
+            throw std::invalid_argument("Prefetching requires at least 2 buffers");
+        hbool_t threadsafe = false;
+        H5is_library_threadsafe(&threadsafe);
+        if (!threadsafe)
+            throw std::runtime_error("Prefetching requires a thread-safe build of the H5 library");
+        // The buffer currently in use by the reader counts towards the total
+        m_prefetcher = std::make_unique<Prefetcher>(
+                m_dtype, m_fileDType, m_dataset, m_cacheSize, m_offset, m_nRemainingInDS,
+                nBuffers - 1, m_arena ? m_arena->blockSize() : 0, *m_metrics);
+    }
+
+    bool Reader::useMemoryMap(AccessPattern pattern) {
+        if (m_prefetcher)
+            throw std::logic_error("A prefetching reader cannot be memory mapped");
+        std::unique_ptr<MemoryMap> map =
+                MemoryMap::create(m_dataset, m_fileDType, m_dtype, m_nRows, pattern);
+        if (!map)
+            return false;
+        // Carry on from the same row, now reading from the mapping
+        std::size_t row = position();
+        reclaimCache();
+        m_nInCache = 0;
+        m_cachePosition = 0;
+        m_offset = row;
+        m_nRemainingInDS = m_nRows - row;
+        m_map = std::move(map);
+        return true;
     }
 
     H5BufferConstView Reader::next() {
-        if (m_cachePosition == m_cacheSize) {
-            // We've exhausted our cache
-            if (m_nRemainingInDS == 0)
-                // We've exhausted the whole dataset
-                return {};
-            // How many elements in the next read?
-            hsize_t slabSize = std::min(m_cacheSize, m_nRemainingInDS);
-            H5::DataSpace slabSpace(1, &slabSize);
-            hsize_t offset = m_offset;
-            H5::DataSpace sourceSpace = m_dataset.getSpace();
-            sourceSpace.selectHyperslab(H5S_SELECT_SET, &slabSize, &offset);
-            m_dataset.read(m_buffer.get(), m_dtype, slabSpace, sourceSpace);
+        if (m_cachePosition >= m_nInCache && !fillCache())
+            // We've exhausted the whole dataset
+            return {};
+        return H5BufferConstView(cacheRow(m_cachePosition++), m_dtype);
+    }
+
+    H5BufferConstView Reader::nextBlock(std::size_t n) {
+        if (n == 0 || (m_cachePosition >= m_nInCache && !fillCache()))
+            return {};
+        hsize_t nRows = std::min<hsize_t>(n, m_nInCache - m_cachePosition);
+        const void *rows = cacheRow(m_cachePosition);
+        m_cachePosition += nRows;
+        return H5BufferConstView(rows, H5::ArrayType(m_dtype, 1, &nRows));
+    }
+
+    std::size_t Reader::readInto(H5BufferView buffer, std::size_t n) {
+        std::byte *target = static_cast<std::byte *>(buffer.get());
+        std::size_t nRead = 0;
+        while (nRead < n) {
+            if (m_cachePosition < m_nInCache) {
+                // First use up anything left in the cache
+                std::size_t nCopy = std::min<std::size_t>(n - nRead, m_nInCache - m_cachePosition);
+                IOMetricsRecorder::Scope timer(*m_metrics, IOMetricsRecorder::Timer::Conversion);
+                convert(H5BufferConstView(cacheRow(m_cachePosition), m_dtype),
+                        H5BufferView(target + nRead * buffer.footprint(), buffer.dtype()), nCopy);
+                m_cachePosition += nCopy;
+                nRead += nCopy;
+            } else if (m_prefetcher) {
+                // The background thread owns the read position so go through the cache
+                if (!fillCache())
+                    break;
+            } else {
+                // Then read the rest straight from the dataset
+                hsize_t slabSize = std::min(n - nRead, m_nRemainingInDS);
+                if (slabSize == 0)
+                    break;
+                if (m_map) {
+                    m_metrics->addBlock(slabSize, slabSize * m_objectSize);
+                    IOMetricsRecorder::Scope timer(
+                            *m_metrics, IOMetricsRecorder::Timer::Conversion);
+                    convert(H5BufferConstView(m_map->row(m_offset), m_dtype),
+                            H5BufferView(target + nRead * buffer.footprint(), buffer.dtype()),
+                            slabSize);
+                } else {
+                    // Apply the same checks as convert() does for rows from the cache, H5 does
+                    // not check the conversion itself
+                    if (buffer.dtype() != m_fileDType &&
+                        !ConversionPlanCache::instance()
+                                 .get(m_fileDType, buffer.dtype())
+                                 ->status.check())
+                        throw InvalidConversionError(m_fileDType, buffer.dtype());
+                    readRows(
+                            m_dataset, m_fileDType, target + nRead * buffer.footprint(),
+                            buffer.dtype(), m_offset, slabSize, H5::DSetMemXferPropList::DEFAULT,
+                            *m_metrics);
+                }
+                m_offset += slabSize;
+                m_nRemainingInDS -= slabSize;
+                nRead += slabSize;
+            }
+        }
+        return nRead;
+    }
+
+    void Reader::seek(std::size_t row) {
+        if (m_prefetcher)
+            throw std::logic_error("Cannot seek while prefetching");
+        if (row > m_nRows)
+            throw std::out_of_range(
+                    "Row " + std::to_string(row) + " is beyond the end of the dataset");
+        std::size_t cacheStart = m_offset - m_nInCache;
+        if (row >= cacheStart && row < m_offset) {
+            m_cachePosition = row - cacheStart;
+            return;
+        }
+        reclaimCache();
+        m_nInCache = 0;
+        m_cachePosition = 0;
+        m_offset = row;
+        m_nRemainingInDS = m_nRows - row;
+    }
+
+    H5BufferConstView Reader::read(std::size_t row) {
+        if (row >= m_nRows)
+            throw std::out_of_range(
+                    "Row " + std::to_string(row) + " is beyond the end of the dataset");
+        if (m_map)
+            return H5BufferConstView(m_map->row(row), m_dtype);
+        const CachedBlock &block = cachedBlock(row / m_blockRows);
+        return H5BufferConstView(block.buffer.get((row % m_blockRows) * m_objectSize), m_dtype);
+    }
+
+    std::size_t Reader::readRange(std::size_t first, H5BufferView buffer, std::size_t n) {
+        if (first > m_nRows)
+            throw std::out_of_range(
+                    "Row " + std::to_string(first) + " is beyond the end of the dataset");
+        n = std::min(n, m_nRows - first);
+        std::byte *target = static_cast<std::byte *>(buffer.get());
+        if (m_map) {
+            IOMetricsRecorder::Scope timer(*m_metrics, IOMetricsRecorder::Timer::Conversion);
+            convert(H5BufferConstView(m_map->row(first), m_dtype), buffer, n);
+            return n;
+        }
+        for (std::size_t nRead = 0; nRead < n;) {
+            std::size_t row = first + nRead;
+            const CachedBlock &block = cachedBlock(row / m_blockRows);
+            std::size_t position = row % m_blockRows;
+            std::size_t nCopy = std::min<std::size_t>(n - nRead, block.nRows - position);
+            IOMetricsRecorder::Scope timer(*m_metrics, IOMetricsRecorder::Timer::Conversion);
+            convert(H5BufferConstView(block.buffer.get(position * m_objectSize), m_dtype),
+                    H5BufferView(target + nRead * buffer.footprint(), buffer.dtype()), nCopy);
+            nRead += nCopy;
+        }
+        return n;
+    }
+
+    std::vector<std::size_t> Reader::equalRange(const std::vector<H5BufferConstView> &key) {
+        if (!m_index)
+            m_index = std::make_unique<DataSetIndex>(m_dataset);
+        return m_index->equalRange(key);
+    }
+
+    std::optional<std::size_t> Reader::find(const std::vector<H5BufferConstView> &key) {
+        if (!m_index)
+            m_index = std::make_unique<DataSetIndex>(m_dataset);
+        return m_index->find(key);
+    }
+
+    void Reader::setBlockCacheSize(std::size_t nBlocks) {
+        if (nBlocks == 0)
+            throw std::invalid_argument("The block cache must hold at least one block");
+        m_blockCacheSize = nBlocks;
+        while (m_blocks.size() > m_blockCacheSize)
+            evictBlock();
+    }
+
+    bool Reader::fillCache() {
+        if (m_nRemainingInDS == 0)
+            return false;
+        // Free any vlen memory from the previous read
+        reclaimCache();
+        m_nInCache = 0;
+        if (m_map) {
+            // Nothing is read, the cache is just moved along the mapping
+            hsize_t slabSize =
+                    std::min<hsize_t>(std::max<hsize_t>(m_cacheSize, 1), m_nRemainingInDS);
+            m_metrics->addBlock(slabSize, slabSize * m_objectSize);
             m_offset += slabSize;
             m_nRemainingInDS -= slabSize;
             m_cachePosition = 0;
             m_nInCache = slabSize;
+            m_map->willNeed(m_offset, std::min<hsize_t>(slabSize, m_nRemainingInDS));
+            if (m_metricsCallback)
+                m_metricsCallback(m_metrics->snapshot());
+            return true;
+        }
+        if (m_prefetcher) {
+            std::optional<Prefetcher::Block> block = m_prefetcher->pop();
+            if (!block)
+                return false;
+            m_prefetcher->recycle(std::move(m_buffer), std::move(m_arena));
+            m_buffer = std::move(block->buffer);
+            m_arena = std::move(block->arena);
+            m_offset += block->nRows;
+            m_nRemainingInDS -= block->nRows;
+            m_cachePosition = 0;
+            m_nInCache = block->nRows;
+            if (m_metricsCallback)
+                m_metricsCallback(m_metrics->snapshot());
+            return true;
         }
-        std::size_t cacheOffset = m_cachePosition * m_dtype.getSize();
-        ++m_cachePosition;
-        return H5BufferConstView(m_buffer.get(cacheOffset), m_dtype);
+        // How many elements in the next read?
+        hsize_t slabSize = std::min(m_cacheSize, m_nRemainingInDS);
+        readRows(
+                m_dataset, m_fileDType, m_buffer.get(), m_dtype, m_offset, slabSize,
+                m_arena ? m_arena->transferPropList() : H5::DSetMemXferPropList::DEFAULT,
+                *m_metrics);
+        m_offset += slabSize;
+        m_nRemainingInDS -= slabSize;
+        m_cachePosition = 0;
+        m_nInCache = slabSize;
+        if (m_metricsCallback)
+            m_metricsCallback(m_metrics->snapshot());
+        return true;
+    }
+
+    const Reader::CachedBlock &Reader::cachedBlock(std::size_t index) {
+        auto itr = m_blockIndex.find(index);
+        if (itr != m_blockIndex.end()) {
+            m_blocks.splice(m_blocks.begin(), m_blocks, itr->second);
+            return m_blocks.front();
+        }
+        SmartBuffer buffer;
+        if (m_blocks.size() >= m_blockCacheSize)
+            buffer = evictBlock();
+        else
+            buffer = SmartBuffer(m_blockRows * m_objectSize, BufferAllocator::cache());
+        std::size_t first = index * m_blockRows;
+        hsize_t nRows = std::min(m_blockRows, m_nRows - first);
+        readRows(
+                m_dataset, m_fileDType, buffer.get(), m_dtype, first, nRows,
+                H5::DSetMemXferPropList::DEFAULT, *m_metrics);
+        m_blocks.push_front(CachedBlock{index, std::move(buffer), nRows});
+        m_blockIndex[index] = m_blocks.begin();
+        return m_blocks.front();
+    }
+
+    SmartBuffer Reader::evictBlock() {
+        CachedBlock &block = m_blocks.back();
+        {
+            IOMetricsRecorder::Scope timer(*m_metrics, IOMetricsRecorder::Timer::Reclaim);
+            H5Dvlen_reclaim(
+                    m_dtype.getId(), H5::DataSpace(1, &block.nRows).getId(), H5P_DEFAULT,
+                    block.buffer.get());
+        }
+        SmartBuffer buffer = std::move(block.buffer);
+        m_blockIndex.erase(block.index);
+        m_blocks.pop_back();
+        return buffer;
+    }
+
+    const void *Reader::cacheRow(std::size_t position) {
+        if (m_map)
+            return m_map->row(m_offset - m_nInCache + position);
+        return m_buffer.get(position * m_objectSize);
+    }
+
+    void Reader::reclaimCache() {
+        if (m_map)
+            // The cache is part of the mapping and holds no vlen data
+            return;
+        IOMetricsRecorder::Scope timer(*m_metrics, IOMetricsRecorder::Timer::Reclaim);
+        if (m_arena)
+            m_arena->reset();
+        else if (m_nInCache)
+            H5Dvlen_reclaim(
+                    m_dtype.getId(), H5::DataSpace(1, &m_nInCache).getId(), H5P_DEFAULT,
+                    m_buffer.get());
     }
 } // namespace H5Composites
\ No newline at end of file
@@ -1,22 +1,40 @@
 #include "H5Composites/SmartBuffer.hxx"
+#include <algorithm>
 #include <cstdlib>
 #include <cstring>
 
 namespace H5Composites {
     SmartBuffer::SmartBuffer() : SmartBuffer(nullptr) {}
 
-    SmartBuffer::SmartBuffer(std::size_t size) : SmartBuffer(std::malloc(size)) {}
+    SmartBuffer::SmartBuffer(std::size_t size)
+            : SmartBuffer(size, BufferAllocator::standard()) {}
+
+    SmartBuffer::SmartBuffer(std::size_t size, const BufferAllocator &allocator)
+            : m_buffer(allocator.allocate(size)), m_size(size), m_allocator(&allocator) {}
 
     SmartBuffer::SmartBuffer(std::size_t size, unsigned char fill) : SmartBuffer(size) {
         std::memset(m_buffer, fill, size);
     }
 
-    SmartBuffer::SmartBuffer(void *buffer) : m_buffer(buffer) {}
+    SmartBuffer::SmartBuffer(void *buffer)
+            : m_buffer(buffer), m_allocator(&BufferAllocator::standard()) {}
 
-    SmartBuffer::SmartBuffer(SmartBuffer &&other) : SmartBuffer(other.release()) {}
+    SmartBuffer::SmartBuffer(SmartBuffer &&other)
+            : m_buffer(other.m_buffer), m_size(other.m_size), m_allocator(other.m_allocator) {
+        other.m_buffer = nullptr;
+        other.m_size = 0;
+    }
 
     SmartBuffer &SmartBuffer::operator=(SmartBuffer &&other) {
-        reset(other.release());
+        if (this != &other) {
+            if (m_buffer)
+                m_allocator->deallocate(m_buffer, m_size);
+            m_buffer = other.m_buffer;
+            m_size = other.m_size;
+            m_allocator = other.m_allocator;
+            other.m_buffer = nullptr;
+            other.m_size = 0;
+        }
         return *this;
     }
 
@@ -25,7 +43,10 @@ namespace H5Composites {
         return *this;
     }
 
-    SmartBuffer::~SmartBuffer() { std::free(m_buffer); }
+    SmartBuffer::~SmartBuffer() {
+        if (m_buffer)
+            m_allocator->deallocate(m_buffer, m_size);
+    }
 
     SmartBuffer SmartBuffer::copy(const void *ptr, std::size_t nBytes, std::size_t n) {
         SmartBuffer buffer(nBytes * n);
@@ -38,7 +59,8 @@ namespace H5Composites {
 
     void SmartBuffer::reset(void *buffer) {
         try {
-            std::free(m_buffer);
+            if (m_buffer)
+                m_allocator->deallocate(m_buffer, m_size);
         } catch (...) {
             // In case of an exception we need to free the memory we've just been handed
             std::free(buffer);
@@ -47,6 +69,8 @@ namespace H5Composites {
         }
         // If we get here then it's OK and we can take ownership
         m_buffer = buffer;
+        m_size = 0;
+        m_allocator = &BufferAllocator::standard();
     }
 
     void *SmartBuffer::get() { return m_buffer; }
@@ -63,14 +87,29 @@ namespace H5Composites {
     void *SmartBuffer::release() {
         void *tmp = m_buffer;
         m_buffer = nullptr;
+        m_size = 0;
         return tmp;
     }
 
     bool SmartBuffer::resize(std::size_t size) {
-        void *reallocated = std::realloc(m_buffer, size);
+        if (m_allocator == &BufferAllocator::standard()) {
+            void *reallocated = std::realloc(m_buffer, size);
+            if (reallocated == nullptr)
+                return false;
+            m_buffer = reallocated;
+            m_size = size;
+            return true;
+        }
+        // Other allocators cannot grow in place so copy into a new allocation
+        void *reallocated = m_allocator->allocate(size);
         if (reallocated == nullptr)
             return false;
+        if (m_buffer) {
+            std::memcpy(reallocated, m_buffer, std::min(m_size, size));
+            m_allocator->deallocate(m_buffer, m_size);
+        }
         m_buffer = reallocated;
+        m_size = size;
         return true;
     }
 
@@ -1,6 +1,8 @@
 #include "H5Composites/TypeRegister.hxx"
 #include "H5Composites/BufferConstructTraits.hxx"
 
+#include <algorithm>
+
 namespace H5Composites {
     TypeRegister &TypeRegister::instance() {
         static TypeRegister instance;
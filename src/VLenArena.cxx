@@ -0,0 +1,94 @@
+#include "H5Composites/VLenArena.hxx"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <new>
+
+namespace {
+    thread_local H5Composites::VLenArena *currentArena = nullptr;
+
+    constexpr std::size_t alignment = alignof(std::max_align_t);
+} // namespace
+
+namespace H5Composites {
+    VLenArena::VLenArena(std::size_t blockSize) : m_blockSize(blockSize) {
+        if (H5Pset_vlen_mem_manager(
+                    m_transferPropList.getId(), &VLenArena::allocateCallback, this,
+                    &VLenArena::freeCallback, this) < 0)
+            throw H5::PropListIException(
+                    "VLenArena::VLenArena", "Failed to set the vlen memory manager");
+    }
+
+    void *VLenArena::allocate(std::size_t size) {
+        // Round up so that the next allocation stays aligned
+        size = (size + alignment - 1) / alignment * alignment;
+        for (; m_currentBlock < m_blocks.size(); ++m_currentBlock, m_position = 0) {
+            auto &[block, blockSize] = m_blocks[m_currentBlock];
+            if (m_position + size <= blockSize) {
+                void *ptr = block.get(m_position);
+                m_position += size;
+                return ptr;
+            }
+        }
+        std::size_t blockSize = std::max(m_blockSize, size);
+        SmartBuffer block(blockSize);
+        if (!block)
+            throw std::bad_alloc();
+        m_blocks.emplace_back(std::move(block), blockSize);
+        m_currentBlock = m_blocks.size() - 1;
+        m_position = size;
+        return m_blocks.back().first.get();
+    }
+
+    bool VLenArena::owns(const void *ptr) const {
+        std::less<const void *> less;
+        for (const auto &[block, blockSize] : m_blocks)
+            if (!less(ptr, block.get()) && less(ptr, block.get(blockSize)))
+                return true;
+        return false;
+    }
+
+    void VLenArena::reset() {
+        m_currentBlock = 0;
+        m_position = 0;
+    }
+
+    std::size_t VLenArena::capacity() const {
+        std::size_t total = 0;
+        for (const auto &[_, blockSize] : m_blocks)
+            total += blockSize;
+        return total;
+    }
+
+    VLenArena *VLenArena::current() { return currentArena; }
+
+    const H5::PropList &VLenArena::currentTransferPropList() {
+        return currentArena ? currentArena->transferPropList() : H5::PropList::DEFAULT;
+    }
+
+    VLenArena::Scope::Scope(VLenArena *arena) : m_previous(currentArena) { currentArena = arena; }
+
+    VLenArena::Scope::~Scope() { currentArena = m_previous; }
+
+    void *VLenArena::allocateCallback(std::size_t size, void *info) {
+        // Exceptions cannot pass through the H5 library, which treats a null pointer as a failure
+        try {
+            return static_cast<VLenArena *>(info)->allocate(size);
+        } catch (const std::bad_alloc &) {
+            return nullptr;
+        }
+    }
+
+    void VLenArena::freeCallback(void *ptr, void *info) {
+        if (!static_cast<VLenArena *>(info)->owns(ptr))
+            std::free(ptr);
+    }
+
+    void *allocateVLen(std::size_t size) {
+        if (currentArena)
+            return currentArena->allocate(size);
+        return std::malloc(size);
+    }
+} // namespace H5Composites
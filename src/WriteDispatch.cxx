@@ -0,0 +1,31 @@
+#include "H5Composites/WriteDispatch.hxx"
+#include "H5Composites/DTypeIterator.hxx"
+
+namespace {
+    bool hasVLenData(const H5::DataType &dtype) {
+        if (H5Tdetect_class(dtype.getId(), H5T_VLEN) > 0)
+            return true;
+        // Variable length strings are not a separate class so check them separately
+        for (H5Composites::DTypeIterator itr(dtype);
+             itr.elemType() != H5Composites::DTypeIterator::ElemType::End; ++itr)
+            if (itr.elemType() == H5Composites::DTypeIterator::ElemType::String &&
+                itr->isVariableStr())
+                return true;
+        return false;
+    }
+} // namespace
+
+namespace H5Composites {
+    DirectWriteCheck::DirectWriteCheck(const H5::DataType &dtype)
+            : m_dtype(dtype), m_hasVLenData(hasVLenData(dtype)), m_directDType(dtype) {}
+
+    bool DirectWriteCheck::operator()(const H5::DataType &dtype) {
+        // Holding a copy of the matched type keeps its ID alive so comparing IDs is safe
+        if (dtype.getId() == m_directDType.getId())
+            return true;
+        if (dtype != m_dtype)
+            return false;
+        m_directDType = dtype;
+        return true;
+    }
+} // namespace H5Composites
@@ -1,81 +1,407 @@
 #include "H5Composites/Writer.hxx"
 #include "H5Composites/DTypeConversion.hxx"
+#include "H5Composites/DataSetIndex.hxx"
 #include "H5Composites/traits/String.hxx"
 #include "H5Composites/traits/Vector.hxx"
 
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
 #include <cstring>
+#include <deque>
+#include <exception>
+#include <iostream>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+namespace {
+    using H5Composites::IOMetricsRecorder;
+
+    /// Append n objects held in the buffer to the 1D dataset, starting at the provided offset
+    void appendToDataSet(
+            H5::DataSet &dataset, hsize_t offset, const void *buffer, const H5::DataType &dtype,
+            std::size_t n, IOMetricsRecorder &metrics) {
+        // Calculate the space of the dataset we're about to write
+        hsize_t slabSize[1]{n};
+        H5::DataSpace slabSpace(1, slabSize);
+        // Calculate the space of the full dataset on disk (after this write)
+        hsize_t fullSize[1]{offset + n};
+        {
+            IOMetricsRecorder::Scope timer(metrics, IOMetricsRecorder::Timer::Extend);
+            dataset.extend(fullSize);
+        }
+
+        {
+            IOMetricsRecorder::Scope timer(metrics, IOMetricsRecorder::Timer::IO);
+            // Select the area in the output dataset to write
+            H5::DataSpace targetSpace = dataset.getSpace();
+            targetSpace.selectHyperslab(H5S_SELECT_SET, slabSize, &offset);
+            // Now write the data held in the buffer
+            dataset.write(buffer, dtype, slabSpace, targetSpace);
+        }
+        metrics.addBlock(n, n * dtype.getSize());
+    }
+} // namespace
 
 namespace H5Composites {
+    /// @brief Writes full buffers to the dataset in a background thread
+    ///
+    /// The number of buffers is fixed: each time the writer hands over a full buffer it receives
+    /// an empty one in exchange, waiting for the thread to finish with one if none are available.
+    class Writer::Flusher {
+    public:
+        /// @param arenaBlockSize If not 0, each buffer has a vlen arena with this block size
+        Flusher(const H5::DataType &dtype, const H5::DataSet &dataset, std::size_t bufferSize,
+                std::size_t nBuffers, std::size_t arenaBlockSize, IOMetricsRecorder &metrics)
+                : m_dtype(dtype), m_dataset(dataset), m_metrics(metrics) {
+            for (std::size_t idx = 0; idx < nBuffers; ++idx)
+                m_free.push_back(Block{
+                        SmartBuffer(bufferSize, BufferAllocator::cache()),
+                        arenaBlockSize ? std::make_unique<VLenArena>(arenaBlockSize) : nullptr, 0,
+                        0});
+            m_thread = std::thread(&Flusher::run, this);
+        }
+
+        ~Flusher() {
+            {
+                std::lock_guard lock(m_mutex);
+                m_stop = true;
+            }
+            m_cv.notify_all();
+            m_thread.join();
+            // Anything left over is only here if there was an error
+            for (Block &block : m_queue)
+                reclaim(block);
+        }
+
+        /// @brief Queue a full buffer to be written and receive an empty one in exchange
+        /// @param buffer The full buffer
+        /// @param arena The arena holding the buffer's vlen data (if any). Replaced by the arena
+        ///        belonging to the returned buffer
+        /// @param nRows The number of rows in the buffer
+        /// @param offset The position in the dataset to write the rows
+        SmartBuffer push(
+                SmartBuffer &&buffer, std::unique_ptr<VLenArena> &arena, hsize_t nRows,
+                hsize_t offset) {
+            std::unique_lock lock(m_mutex);
+            m_cv.wait(lock, [this] { return !m_free.empty() || m_error; });
+            if (m_error)
+                std::rethrow_exception(m_error);
+            Block empty = std::move(m_free.front());
+            m_free.pop_front();
+            m_queue.push_back(Block{std::move(buffer), std::move(arena), nRows, offset});
+            lock.unlock();
+            m_cv.notify_all();
+            arena = std::move(empty.arena);
+            return std::move(empty.buffer);
+        }
+
+        /// @brief Wait for the queue to be empty
+        void sync() {
+            std::unique_lock lock(m_mutex);
+            m_cv.wait(lock, [this] { return (m_queue.empty() && !m_busy) || m_error; });
+            if (m_error)
+                std::rethrow_exception(m_error);
+        }
+
+        /// @brief Rethrow any error from the background thread
+        void checkError() {
+            std::lock_guard lock(m_mutex);
+            if (m_error)
+                std::rethrow_exception(m_error);
+        }
+
+    private:
+        struct Block {
+            SmartBuffer buffer;
+            std::unique_ptr<VLenArena> arena;
+            hsize_t nRows;
+            hsize_t offset;
+        };
+
+        void reclaim(Block &block) {
+            IOMetricsRecorder::Scope timer(m_metrics, IOMetricsRecorder::Timer::Reclaim);
+            if (block.arena)
+                block.arena->reset();
+            else
+                H5Dvlen_reclaim(
+                        m_dtype.getId(), H5::DataSpace(1, &block.nRows).getId(), H5P_DEFAULT,
+                        block.buffer.get());
+        }
+
+        void run() {
+            std::unique_lock lock(m_mutex);
+            while (true) {
+                m_cv.wait(lock, [this] { return m_stop || !m_queue.empty(); });
+                if (m_queue.empty() || m_error)
+                    // Only stop once everything has been written
+                    return;
+                m_busy = true;
+                Block block = std::move(m_queue.front());
+                m_queue.pop_front();
+                lock.unlock();
+                try {
+                    appendToDataSet(
+                            m_dataset, block.offset, block.buffer.get(), m_dtype, block.nRows,
+                            m_metrics);
+                    reclaim(block);
+                } catch (...) {
+                    reclaim(block);
+                    lock.lock();
+                    m_error = std::current_exception();
+                    m_busy = false;
+                    m_cv.notify_all();
+                    return;
+                }
+                lock.lock();
+                m_free.push_back(std::move(block));
+                m_busy = false;
+                m_cv.notify_all();
+            }
+        }
+
+        H5::DataType m_dtype;
+        H5::DataSet m_dataset;
+        IOMetricsRecorder &m_metrics;
+        std::mutex m_mutex;
+        std::condition_variable m_cv;
+        std::deque<Block> m_free;
+        std::deque<Block> m_queue;
+        bool m_stop{false};
+        bool m_busy{false};
+        std::exception_ptr m_error;
+        std::thread m_thread;
+    };
+
     Writer::Writer(
             const H5::Group &targetGroup, const std::string &name, const H5::DataType &dtype,
-            std::size_t cacheSize, std::size_t chunkSize)
-            : m_dtype(dtype), m_cacheSize(cacheSize), m_buffer(cacheSize * dtype.getSize()) {
+            std::size_t cacheSize, std::size_t chunkSize, const DataSetCreationOptions &options)
+            : m_dtype(dtype), m_cacheSize(cacheSize), m_objectSize(dtype.getSize()),
+              m_directCheck(m_dtype), m_buffer(cacheSize * m_objectSize, BufferAllocator::cache()),
+              m_metrics(std::make_unique<IOMetricsRecorder>(IOMetricsRecorder::Source::Writer)) {
         if (targetGroup.nameExists(name))
             throw std::invalid_argument(name + " already exists in H5 group");
         hsize_t startDimension[1]{0};
         hsize_t maxDimension[1]{H5S_UNLIMITED};
         H5::DSetCreatPropList propList;
         if (chunkSize == SIZE_MAX)
-            chunkSize = cacheSize;
+            chunkSize = options.autoChunk() ? options.chunkRows(m_objectSize) : cacheSize;
         hsize_t chunks[1]{static_cast<hsize_t>(chunkSize)};
         propList.setChunk(1, chunks);
+        options.apply(propList);
+        H5::DSetAccPropList accessPropList;
+        DataSetCreationOptions::applyChunkCache(accessPropList, chunkSize * m_objectSize);
         m_dataset = targetGroup.createDataSet(
-                name, m_dtype, H5::DataSpace(1, startDimension, maxDimension), propList);
+                name, m_dtype, H5::DataSpace(1, startDimension, maxDimension), propList,
+                accessPropList);
     }
 
     Writer::Writer(Writer &&other)
             : m_dtype(std::move(other.m_dtype)), m_cacheSize(other.m_cacheSize),
+              m_objectSize(other.m_objectSize), m_directCheck(other.m_directCheck),
               m_dataset(std::move(other.m_dataset)), m_offset(other.m_offset),
-              m_nInBuffer(other.m_nInBuffer), m_buffer(std::move(other.m_buffer)) {
+              m_nInBuffer(other.m_nInBuffer), m_buffer(std::move(other.m_buffer)),
+              m_metrics(std::move(other.m_metrics)),
+              m_metricsCallback(std::move(other.m_metricsCallback)),
+              m_flusher(std::move(other.m_flusher)), m_arena(std::move(other.m_arena)) {
+#ifdef H5_HAVE_PARALLEL
+        m_comm = other.m_comm;
+        m_maxCacheSize = other.m_maxCacheSize;
+        other.m_comm = MPI_COMM_NULL;
+#endif
+        other.m_metrics = std::make_unique<IOMetricsRecorder>(IOMetricsRecorder::Source::Writer);
         other.clear();
     }
 
-    Writer::~Writer() { flush(); }
+    Writer::~Writer() {
+        // Cannot throw from a destructor so this is the last chance to report any error
+        try {
+            flush();
+            sync();
+        } catch (const H5::Exception &e) {
+            std::cerr << "Failed to write " << m_dataset.getObjName() << ": " << e.getDetailMsg()
+                      << std::endl;
+        } catch (const std::exception &e) {
+            std::cerr << "Failed to write " << m_dataset.getObjName() << ": " << e.what()
+                      << std::endl;
+        } catch (...) {
+            std::cerr << "Failed to write " << m_dataset.getObjName() << ": unknown error"
+                      << std::endl;
+        }
+        // Free the vlen data of anything that could not be written
+        clear();
+#ifdef H5_HAVE_PARALLEL
+        if (m_comm != MPI_COMM_NULL)
+            MPI_Comm_free(&m_comm);
+#endif
+    }
 
     void Writer::clear() {
         // Setting the buffer position back to 0 effectively discards the data we already have.
         // This is all technically contained in the buffer but will now be ignored by flush calls
         // and overwritten by write calls. The only thing we have to do after that is to delete the
-        // vlen data
-        hsize_t bufferSize = nInBuffer();
-        H5Dvlen_reclaim(
-                m_dtype.getId(), H5::DataSpace(1, &bufferSize).getId(), H5P_DEFAULT,
-                m_buffer.get());
+        // vlen data, which for an arena just means resetting it
+        IOMetricsRecorder::Scope timer(*m_metrics, IOMetricsRecorder::Timer::Reclaim);
+        if (m_arena)
+            m_arena->reset();
+        else {
+            hsize_t bufferSize = nInBuffer();
+            H5Dvlen_reclaim(
+                    m_dtype.getId(), H5::DataSpace(1, &bufferSize).getId(), H5P_DEFAULT,
+                    m_buffer.get());
+        }
         m_nInBuffer = 0;
     }
 
     void Writer::flush() {
-        // If the buffer is empty then do nothing
-        if (m_nInBuffer == 0)
+#ifdef H5_HAVE_PARALLEL
+        if (isCollective()) {
+            // Every rank has to take part, even those with nothing to write
+            collectiveFlush();
+            clear();
+            if (m_metricsCallback)
+                m_metricsCallback(m_metrics->snapshot());
             return;
-        // Calculate the space of the dataset we're about to write
-        hsize_t slabSize[1]{m_nInBuffer};
-        H5::DataSpace slabSpace(1, slabSize);
-        // Calculate the space of the full dataset on disk (after this write)
-        hsize_t fullSize[1]{m_offset + m_nInBuffer};
-        m_dataset.extend(fullSize);
-
-        // Calculate where in the output dataset to write
-        hsize_t offset[1]{m_offset};
-        // Select this area in the output dataset
-        H5::DataSpace targetSpace = m_dataset.getSpace();
-        targetSpace.selectHyperslab(H5S_SELECT_SET, slabSize, offset);
-        // Now write the data held in the buffer
-        m_dataset.write(m_buffer.get(), m_dtype, slabSpace, targetSpace);
-        // Increment the offset and clear the buffer
-        m_offset += m_nInBuffer;
-        clear();
+        }
+#endif
+        if (m_flusher) {
+            m_flusher->checkError();
+            if (m_nInBuffer == 0)
+                return;
+            // Swap the full buffer for an empty one. The background thread takes ownership of
+            // any vlen data in the old buffer
+            m_buffer = m_flusher->push(std::move(m_buffer), m_arena, m_nInBuffer, m_offset);
+            m_offset += m_nInBuffer;
+            m_nInBuffer = 0;
+        } else {
+            // If the buffer is empty then do nothing
+            if (m_nInBuffer == 0)
+                return;
+            writeToDataSet(m_buffer.get(), m_dtype, m_nInBuffer);
+            // Clear the buffer
+            clear();
+        }
+        if (m_metricsCallback)
+            m_metricsCallback(m_metrics->snapshot());
+    }
+
+    void Writer::startAsyncFlushing(std::size_t queueDepth) {
+        if (m_flusher)
+            throw std::logic_error("Writer is already flushing asynchronously");
+        if (collective())
+            throw std::logic_error("A collective writer cannot flush asynchronously");
+        if (queueDepth == 0)
+            throw std::invalid_argument("Asynchronous flushing requires a queue depth above 0");
+        hbool_t threadsafe = false;
+        H5is_library_threadsafe(&threadsafe);
+        if (!threadsafe)
+            throw std::runtime_error(
+                    "Asynchronous flushing requires a thread-safe build of the H5 library");
+        m_flusher = std::make_unique<Flusher>(
+                m_dtype, m_dataset, m_cacheSize * m_objectSize, queueDepth,
+                m_arena ? m_arena->blockSize() : 0, *m_metrics);
+    }
+
+    void Writer::useVLenArena(std::size_t blockSize) {
+        if (m_flusher)
+            throw std::logic_error("The vlen arena must be set before asynchronous flushing");
+        flush();
+        m_arena = std::make_unique<VLenArena>(blockSize);
     }
 
+    void Writer::sync() {
+        if (m_flusher)
+            m_flusher->sync();
+    }
+
+#ifdef H5_HAVE_PARALLEL
+    void Writer::useCollectiveIO(MPI_Comm comm, std::size_t maxCacheSize) {
+        if (m_flusher)
+            throw std::logic_error("A writer flushing asynchronously cannot be collective");
+        if (m_offset != 0 || m_nInBuffer != 0)
+            throw std::logic_error("Collective writing must start before any rows are written");
+        hid_t fileID = H5Iget_file_id(m_dataset.getId());
+        hid_t accessPropList = H5Fget_access_plist(fileID);
+        bool mpio = H5Pget_driver(accessPropList) == H5FD_MPIO;
+        H5Pclose(accessPropList);
+        H5Fclose(fileID);
+        if (!mpio)
+            throw std::invalid_argument("Collective writing requires a file using MPI-IO");
+        if (maxCacheSize < m_cacheSize)
+            throw std::invalid_argument("The maximum cache size is below the current one");
+        m_maxCacheSize = maxCacheSize;
+        if (m_comm != MPI_COMM_NULL)
+            MPI_Comm_free(&m_comm);
+        // Use a private communicator so that our messages cannot mix with the caller's
+        MPI_Comm_dup(comm, &m_comm);
+    }
+#endif
+
     H5BufferConstView Writer::buffer() const {
         hsize_t dims[1]{m_nInBuffer};
         return {m_buffer.get(), H5::ArrayType(m_dtype, 1, dims)};
     }
 
     void Writer::writeFromBuffer(const H5BufferConstView &buffer) {
-        convert(buffer, H5BufferView(m_buffer.get(m_nInBuffer * m_dtype.getSize()), m_dtype));
-        if (++m_nInBuffer == m_cacheSize)
+        {
+            VLenArena::Scope scope(m_arena.get());
+            IOMetricsRecorder::Scope timer(*m_metrics, IOMetricsRecorder::Timer::Conversion);
+            convert(buffer, nextSlot());
+        }
+        commitSlot();
+    }
+
+    void Writer::writeFromBuffer(const H5BufferConstView &buffer, std::size_t n) {
+        // Rows with vlen data are converted even if the types match, as a plain copy would leave
+        // the cache sharing (and later freeing) the caller's memory
+        bool direct = m_directCheck.canCopyBytes(buffer.dtype());
+        std::shared_ptr<const ConversionPlan> plan;
+        if (!direct)
+            plan = ConversionPlanCache::instance().get(buffer.dtype(), m_dtype);
+        // Conversions that the MemberwiseConverter handles are much faster than H5's, so those
+        // always go through the cache a block at a time
+        if (n > m_cacheSize && !collective() && (direct || !plan->memberwise)) {
+            // Bypass the cache entirely. Check the conversion here as H5 will not
+            if (plan && !plan->status.check())
+                throw InvalidConversionError(buffer.dtype(), m_dtype);
             flush();
+            // Anything queued in the background has to reach the file first
+            sync();
+            writeToDataSet(buffer.get(), buffer.dtype(), n);
+            if (m_metricsCallback)
+                m_metricsCallback(m_metrics->snapshot());
+            return;
+        }
+        const std::byte *source = static_cast<const std::byte *>(buffer.get());
+        for (std::size_t idx = 0; idx < n;) {
+            std::size_t nToWrite = std::min(n - idx, m_cacheSize - m_nInBuffer);
+            if (direct)
+                std::memcpy(
+                        m_buffer.get(m_nInBuffer * m_objectSize), source + idx * m_objectSize,
+                        nToWrite * m_objectSize);
+            else {
+                // Flushing can swap the arena so only make it current for the conversion
+                VLenArena::Scope scope(m_arena.get());
+                IOMetricsRecorder::Scope timer(*m_metrics, IOMetricsRecorder::Timer::Conversion);
+                convert(H5BufferConstView(source + idx * buffer.footprint(), buffer.dtype()),
+                        nextSlot(), nToWrite);
+            }
+            idx += nToWrite;
+            m_nInBuffer += nToWrite;
+            if (m_nInBuffer == m_cacheSize)
+                cacheFull();
+        }
+    }
+
+    void Writer::writeDirect(const void *obj) {
+        if (m_nInBuffer == m_cacheSize)
+            // Only left full if making space failed
+            cacheFull();
+        std::memcpy(m_buffer.get(m_nInBuffer * m_objectSize), obj, m_objectSize);
+        commitSlot();
     }
 
     void Writer::setIndex(const std::string &name) { setAttribute("index", toBuffer(name)); }
@@ -84,9 +410,100 @@ namespace H5Composites {
         setAttribute("index", toBuffer(name));
     }
 
+    void Writer::buildIndex() {
+        if (collective())
+            throw std::logic_error("Build the index once the collectively written file is closed");
+        flush();
+        sync();
+        DataSetIndex::build(m_dataset);
+    }
+
     void Writer::setAttribute(const std::string &name, const H5BufferConstView &value) {
         m_dataset.createAttribute(name, value.dtype(), H5S_SCALAR)
                 .write(value.dtype(), value.get());
     }
 
+    void Writer::writeToDataSet(const void *buffer, const H5::DataType &dtype, std::size_t n) {
+        appendToDataSet(m_dataset, m_offset, buffer, dtype, n, *m_metrics);
+        m_offset += n;
+    }
+
+    H5BufferView Writer::nextSlot() {
+        if (m_nInBuffer == m_cacheSize)
+            // Only left full if making space failed
+            cacheFull();
+        return H5BufferView(m_buffer.get(m_nInBuffer * m_objectSize), m_dtype);
+    }
+
+    void Writer::commitSlot() {
+        if (++m_nInBuffer == m_cacheSize)
+            cacheFull();
+    }
+
+    void Writer::cacheFull() {
+        if (!collective())
+            return flush();
+#ifdef H5_HAVE_PARALLEL
+        // Collective flushes only happen when every rank asks for one
+        std::size_t newSize = std::min(2 * m_cacheSize, m_maxCacheSize);
+        if (newSize == m_cacheSize)
+            throw std::length_error(
+                    "Collective writer cache is full at " + std::to_string(m_cacheSize) +
+                    " rows, flush on every rank more often or raise the limit");
+        if (!m_buffer.resize(newSize * m_objectSize))
+            throw std::bad_alloc();
+        m_cacheSize = newSize;
+#endif
+    }
+
+    bool Writer::collective() const {
+#ifdef H5_HAVE_PARALLEL
+        return isCollective();
+#else
+        return false;
+#endif
+    }
+
+#ifdef H5_HAVE_PARALLEL
+    void Writer::collectiveFlush() {
+        unsigned long long nRows = m_nInBuffer;
+        unsigned long long before = 0;
+        unsigned long long total = 0;
+        int rank;
+        MPI_Comm_rank(m_comm, &rank);
+        MPI_Exscan(&nRows, &before, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, m_comm);
+        // The result on the first rank is undefined
+        if (rank == 0)
+            before = 0;
+        MPI_Allreduce(&nRows, &total, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, m_comm);
+        if (total == 0)
+            return;
+        hsize_t fullSize[1]{m_offset + total};
+        {
+            IOMetricsRecorder::Scope timer(*m_metrics, IOMetricsRecorder::Timer::Extend);
+            m_dataset.extend(fullSize);
+        }
+        {
+            IOMetricsRecorder::Scope timer(*m_metrics, IOMetricsRecorder::Timer::IO);
+            hsize_t slabSize[1]{nRows};
+            hsize_t offset[1]{m_offset + before};
+            // Ranks with no rows still join the transfer, with nothing selected
+            H5::DataSpace slabSpace(1, slabSize);
+            H5::DataSpace targetSpace = m_dataset.getSpace();
+            if (nRows) {
+                targetSpace.selectHyperslab(H5S_SELECT_SET, slabSize, offset);
+            } else {
+                slabSpace.selectNone();
+                targetSpace.selectNone();
+            }
+            H5::DSetMemXferPropList transfer;
+            H5Pset_dxpl_mpio(transfer.getId(), H5FD_MPIO_COLLECTIVE);
+            m_dataset.write(m_buffer.get(), m_dtype, slabSpace, targetSpace, transfer);
+        }
+        if (nRows)
+            m_metrics->addBlock(nRows, nRows * m_objectSize);
+        m_offset += total;
+    }
+#endif
+
 } // namespace H5Composites
\ No newline at end of file
@@ -1,5 +1,8 @@
 #include "H5Composites/traits/String.hxx"
 #include "H5Composites/DTypePrinting.hxx"
+#include "H5Composites/VLenArena.hxx"
+
+#include <cstring>
 
 namespace H5Composites {
 
@@ -20,13 +23,14 @@ namespace H5Composites {
                     "BufferReadTraits<std::string>",
                     toString(buffer.dtype()) + " is not a string data type");
         // Need to allocate enough space for the null character
-        SmartBuffer dataBuffer = SmartBuffer::copy(
-                value.c_str(), sizeof(std::string::value_type) * (value.size() + 1));
+        std::size_t size = sizeof(std::string::value_type) * (value.size() + 1);
         H5::DataType sourceDType = getH5DType(value);
         if (sourceDType == buffer.dtype()) {
-            *(buffer.as<void *>()) = dataBuffer.get();
-            dataBuffer.release();
+            void *data = allocateVLen(size);
+            std::memcpy(data, value.c_str(), size);
+            *(buffer.as<void *>()) = data;
         } else {
+            SmartBuffer dataBuffer = SmartBuffer::copy(value.c_str(), size);
             H5Buffer converted = convert({dataBuffer.get(), sourceDType}, buffer.dtype());
             *(buffer.as<void *>()) = converted.get();
             converted.transferVLenOwnership().release();
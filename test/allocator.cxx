@@ -0,0 +1,45 @@
+#define BOOST_TEST_MODULE allocator
+
+#include "H5Composites/SmartBuffer.hxx"
+#include <boost/test/included/unit_test.hpp>
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+using namespace H5Composites;
+
+BOOST_AUTO_TEST_CASE(aligned) {
+    for (std::size_t size : {1, 63, 64, 1000}) {
+        SmartBuffer buffer(size, BufferAllocator::aligned());
+        std::uintptr_t address = reinterpret_cast<std::uintptr_t>(buffer.get());
+        BOOST_TEST(address % BufferAllocator::alignment == 0);
+    }
+    SmartBuffer huge(BufferAllocator::hugePageSize + 1, BufferAllocator::hugePage());
+    BOOST_TEST(reinterpret_cast<std::uintptr_t>(huge.get()) % BufferAllocator::hugePageSize == 0);
+}
+
+BOOST_AUTO_TEST_CASE(pooled) {
+    void *first;
+    {
+        SmartBuffer buffer(24, BufferAllocator::pooled());
+        first = buffer.get();
+    }
+    // Anything in the same size class reuses the freed memory
+    SmartBuffer buffer(30, BufferAllocator::pooled());
+    BOOST_TEST(buffer.get() == first);
+    std::memset(buffer.get(), 1, 30);
+    BOOST_REQUIRE(buffer.resize(5000));
+    BOOST_TEST(static_cast<unsigned char *>(buffer.get())[29] == 1);
+    // Released memory must always be compatible with std::free
+    std::free(buffer.release());
+}
+
+BOOST_AUTO_TEST_CASE(move) {
+    SmartBuffer buffer(100, BufferAllocator::aligned());
+    SmartBuffer other = std::move(buffer);
+    BOOST_TEST(!buffer);
+    BOOST_TEST(&other.allocator() == &BufferAllocator::aligned());
+    other.reset(std::malloc(10));
+    BOOST_TEST(&other.allocator() == &BufferAllocator::standard());
+}
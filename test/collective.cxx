@@ -0,0 +1,84 @@
+#define BOOST_TEST_MODULE collective
+
+#include "H5Composites/GroupWrapper.hxx"
+#include "H5Composites/H5Struct.hxx"
+#include "H5Composites/TypedReader.hxx"
+#include "H5Composites/TypedWriter.hxx"
+#include <boost/test/included/unit_test.hpp>
+
+#include <mpi.h>
+
+using namespace H5Composites;
+
+struct A {
+    float x;
+    int y;
+
+    H5COMPOSITES_INLINE_STRUCT_DTYPE(A, x, y)
+};
+
+struct MPIFixture {
+    MPIFixture() { MPI_Init(nullptr, nullptr); }
+    ~MPIFixture() { MPI_Finalize(); }
+};
+
+BOOST_TEST_GLOBAL_FIXTURE(MPIFixture);
+
+BOOST_AUTO_TEST_CASE(collective_write) {
+    int rank;
+    int nRanks;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &nRanks);
+    // Each rank writes a different number of rows per flush
+    auto nRows = [](int rank) { return 3 * (rank + 1); };
+    {
+        GroupWrapper file =
+                GroupWrapper::createFile("collective.h5", MPI_COMM_WORLD, MPI_INFO_NULL, true);
+        // A tiny cache so that it has to grow between flushes
+        TypedWriter<A> writer = file.makeDataSetWriter<A>("data", 2);
+        writer.useCollectiveIO(MPI_COMM_WORLD);
+        BOOST_TEST(writer.isCollective());
+        for (int flush = 0; flush < 2; ++flush) {
+            for (int idx = 0; idx < nRows(rank); ++idx)
+                writer.write(A{static_cast<float>(rank), flush * 1000 + idx});
+            writer.flush();
+        }
+    }
+    GroupWrapper file = GroupWrapper::readFile("collective.h5", MPI_COMM_WORLD);
+    TypedReader<A> reader(file.group().openDataSet("data"));
+    for (int flush = 0; flush < 2; ++flush)
+        // Within each flush the rows are ordered by rank
+        for (int source = 0; source < nRanks; ++source)
+            for (int idx = 0; idx < nRows(source); ++idx) {
+                std::optional<A> a = reader.next();
+                BOOST_REQUIRE(a);
+                BOOST_TEST(a->x == source);
+                BOOST_TEST(a->y == flush * 1000 + idx);
+            }
+    BOOST_TEST(!reader.next());
+}
+
+BOOST_AUTO_TEST_CASE(collective_cache_limit) {
+    {
+        GroupWrapper file = GroupWrapper::createFile(
+                "collective_limit.h5", MPI_COMM_WORLD, MPI_INFO_NULL, true);
+        TypedWriter<A> writer = file.makeDataSetWriter<A>("data", 2);
+        writer.useCollectiveIO(MPI_COMM_WORLD, 4);
+        for (int idx = 0; idx < 3; ++idx)
+            writer.write(A{0, idx});
+        BOOST_TEST(writer.cacheSize() == 4);
+        // Filling the cache at its limit fails loudly instead of growing it again
+        BOOST_CHECK_THROW(writer.write(A{0, 3}), std::length_error);
+        BOOST_CHECK_THROW(writer.write(A{0, 4}), std::length_error);
+        BOOST_TEST(writer.nInBuffer() == 4);
+        // A collective flush makes space again
+        writer.flush();
+        writer.write(A{0, 4});
+    }
+    int nRanks;
+    MPI_Comm_size(MPI_COMM_WORLD, &nRanks);
+    GroupWrapper file = GroupWrapper::readFile("collective_limit.h5", MPI_COMM_WORLD);
+    hsize_t nRows;
+    file.group().openDataSet("data").getSpace().getSimpleExtentDims(&nRows);
+    BOOST_TEST(nRows == 5 * nRanks);
+}
@@ -0,0 +1,295 @@
+#define BOOST_TEST_MODULE conversion
+
+#include "H5Composites/DTypeConversion.hxx"
+#include "H5Composites/H5Struct.hxx"
+#include "H5Composites/MemberwiseConverter.hxx"
+#include <boost/test/included/unit_test.hpp>
+
+using namespace H5Composites;
+
+struct A {
+    float x;
+    int y;
+
+    H5COMPOSITES_INLINE_STRUCT_DTYPE(A, x, y)
+};
+
+struct B {
+    double x;
+    long long y;
+
+    H5COMPOSITES_INLINE_STRUCT_DTYPE(B, x, y)
+};
+
+// An older version of NewSchema, with members reordered, narrower and missing
+struct OldSchema {
+    int id;
+    A a;
+    float extra;
+
+    H5COMPOSITES_INLINE_STRUCT_DTYPE(OldSchema, id, a, extra)
+};
+
+struct NewSchema {
+    B a;
+    double added;
+    long long id;
+    short small;
+
+    H5COMPOSITES_INLINE_STRUCT_DTYPE(NewSchema, a, added, id, small)
+};
+
+BOOST_AUTO_TEST_CASE(plan_cache) {
+    ConversionPlanCache &cache = ConversionPlanCache::instance();
+    cache.clear();
+    cache.resetCounters();
+    A a{1.5, -3};
+    B b;
+    convert(viewOf(a), viewOf(b));
+    BOOST_TEST(b.x == 1.5);
+    BOOST_TEST(b.y == -3);
+    BOOST_TEST(cache.nMisses() == 1);
+    BOOST_TEST(cache.nHits() == 0);
+    a.x = 2.5;
+    convert(viewOf(a), viewOf(b));
+    BOOST_TEST(b.x == 2.5);
+    BOOST_TEST(cache.nMisses() == 1);
+    BOOST_TEST(cache.nHits() == 1);
+    BOOST_TEST(cache.size() == 1);
+}
+
+BOOST_AUTO_TEST_CASE(impossible) {
+    int i = 3;
+    char str[4];
+    H5::StrType strType(H5::PredType::C_S1, 4);
+    // The failed conversion must be cached and still raise the second time around
+    BOOST_CHECK_THROW(convert(viewOf(i), H5BufferView(str, strType)), InvalidConversionError);
+    BOOST_CHECK_THROW(convert(viewOf(i), H5BufferView(str, strType)), InvalidConversionError);
+}
+
+BOOST_AUTO_TEST_CASE(batched) {
+    constexpr std::size_t n = 100;
+    A as[n];
+    for (std::size_t idx = 0; idx < n; ++idx)
+        as[idx] = {0.5f * idx, -static_cast<int>(idx)};
+    B bs[n];
+    convert(H5BufferConstView(as, A::h5DType()), H5BufferView(bs, B::h5DType()), n);
+    for (std::size_t idx = 0; idx < n; ++idx) {
+        BOOST_TEST(bs[idx].x == 0.5 * idx);
+        BOOST_TEST(bs[idx].y == -static_cast<long long>(idx));
+    }
+    // Convert back, narrowing into a smaller type
+    A back[n];
+    convert(H5BufferConstView(bs, B::h5DType()), H5BufferView(back, A::h5DType()), n);
+    for (std::size_t idx = 0; idx < n; ++idx) {
+        BOOST_TEST(back[idx].x == as[idx].x);
+        BOOST_TEST(back[idx].y == as[idx].y);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(batched_in_place) {
+    constexpr std::size_t n = 10;
+    double buffer[n];
+    int *ints = reinterpret_cast<int *>(buffer);
+    for (std::size_t idx = 0; idx < n; ++idx)
+        ints[idx] = idx;
+    convert(H5BufferConstView(buffer, H5::PredType::NATIVE_INT),
+            H5BufferView(buffer, H5::PredType::NATIVE_DOUBLE), n);
+    for (std::size_t idx = 0; idx < n; ++idx)
+        BOOST_TEST(buffer[idx] == idx);
+}
+
+BOOST_AUTO_TEST_CASE(memberwise) {
+    std::shared_ptr<const ConversionPlan> plan =
+            ConversionPlanCache::instance().get(OldSchema::h5DType(), NewSchema::h5DType());
+    BOOST_REQUIRE(plan->memberwise);
+    constexpr std::size_t n = 1000;
+    std::vector<OldSchema> old(n);
+    for (std::size_t idx = 0; idx < n; ++idx)
+        old[idx] = {static_cast<int>(idx) - 500, {0.25f * idx, 3 * static_cast<int>(idx)}, 1.f};
+    std::vector<NewSchema> converted(n, NewSchema{{-1, -1}, -1, -1, -1});
+    convert(H5BufferConstView(old.data(), OldSchema::h5DType()),
+            H5BufferView(converted.data(), NewSchema::h5DType()), n,
+            ConversionCriteria{.allowDiscarding = true, .allowUnknown = true});
+    // Compare against the H5 conversion
+    std::vector<NewSchema> expected(n);
+    std::vector<NewSchema> background(n);
+    std::memcpy(expected.data(), old.data(), n * sizeof(OldSchema));
+    H5::DataType(OldSchema::h5DType())
+            .convert(NewSchema::h5DType(), n, expected.data(), background.data());
+    for (std::size_t idx = 0; idx < n; ++idx) {
+        BOOST_TEST(converted[idx].a.x == expected[idx].a.x);
+        BOOST_TEST(converted[idx].a.y == expected[idx].a.y);
+        BOOST_TEST(converted[idx].id == expected[idx].id);
+        BOOST_TEST(converted[idx].added == 0);
+        BOOST_TEST(converted[idx].small == 0);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(memberwise_saturate) {
+    struct Wide {
+        double x;
+        long long y;
+    };
+    struct Narrow {
+        int x;
+        signed char y;
+    };
+    H5::CompType wideType(sizeof(Wide));
+    wideType.insertMember("x", HOFFSET(Wide, x), H5::PredType::NATIVE_DOUBLE);
+    wideType.insertMember("y", HOFFSET(Wide, y), H5::PredType::NATIVE_LLONG);
+    H5::CompType narrowType(sizeof(Narrow));
+    narrowType.insertMember("x", HOFFSET(Narrow, x), H5::PredType::NATIVE_INT);
+    narrowType.insertMember("y", HOFFSET(Narrow, y), H5::PredType::NATIVE_SCHAR);
+    std::unique_ptr<MemberwiseConverter> converter =
+            MemberwiseConverter::create(wideType, narrowType);
+    BOOST_REQUIRE(converter);
+    Wide wide[3]{{1e12, 1000}, {-1e12, -1000}, {-2.5, 5}};
+    Narrow narrow[3];
+    (*converter)(wide, narrow, 3);
+    BOOST_TEST(narrow[0].x == std::numeric_limits<int>::max());
+    BOOST_TEST(narrow[0].y == 127);
+    BOOST_TEST(narrow[1].x == std::numeric_limits<int>::min());
+    BOOST_TEST(narrow[1].y == -128);
+    BOOST_TEST(narrow[2].x == -2);
+    BOOST_TEST(narrow[2].y == 5);
+}
+
+BOOST_AUTO_TEST_CASE(numeric_kernels) {
+    constexpr std::size_t n = 1003;
+    std::vector<double> doubles(n);
+    for (std::size_t idx = 0; idx < n; ++idx)
+        doubles[idx] = 1.1 * idx - 500;
+    BOOST_REQUIRE(ConversionPlanCache::instance()
+                          .get(H5::PredType::NATIVE_DOUBLE, H5::PredType::NATIVE_FLOAT)
+                          ->memberwise);
+    std::vector<float> floats(n);
+    convert(H5BufferConstView(doubles.data(), H5::PredType::NATIVE_DOUBLE),
+            H5BufferView(floats.data(), H5::PredType::NATIVE_FLOAT), n);
+    std::vector<short> shorts(n);
+    convert(H5BufferConstView(doubles.data(), H5::PredType::NATIVE_DOUBLE),
+            H5BufferView(shorts.data(), H5::PredType::NATIVE_SHORT), n);
+    // Compare against the H5 conversions
+    std::vector<double> expected(doubles);
+    H5::DataType(H5::PredType::NATIVE_DOUBLE)
+            .convert(H5::PredType::NATIVE_FLOAT, n, expected.data(), nullptr);
+    BOOST_TEST(std::memcmp(floats.data(), expected.data(), n * sizeof(float)) == 0);
+    expected = doubles;
+    H5::DataType(H5::PredType::NATIVE_DOUBLE)
+            .convert(H5::PredType::NATIVE_SHORT, n, expected.data(), nullptr);
+    BOOST_TEST(std::memcmp(shorts.data(), expected.data(), n * sizeof(short)) == 0);
+
+    double extremes[3]{1e300, -1e300, std::numeric_limits<double>::quiet_NaN()};
+    short saturated[3];
+    convert(H5BufferConstView(extremes, H5::PredType::NATIVE_DOUBLE),
+            H5BufferView(saturated, H5::PredType::NATIVE_SHORT), 3);
+    BOOST_TEST(saturated[0] == std::numeric_limits<short>::max());
+    BOOST_TEST(saturated[1] == std::numeric_limits<short>::min());
+    BOOST_TEST(saturated[2] == 0);
+}
+
+BOOST_AUTO_TEST_CASE(numeric_narrowing) {
+    constexpr std::size_t n = 1003;
+    std::vector<std::int64_t> longs(n);
+    for (std::size_t idx = 0; idx < n; ++idx)
+        longs[idx] = (static_cast<std::int64_t>(idx) - 500) * 10000000;
+    std::vector<std::int32_t> ints(n);
+    convert(H5BufferConstView(longs.data(), H5::PredType::NATIVE_INT64),
+            H5BufferView(ints.data(), H5::PredType::NATIVE_INT32), n);
+    for (std::size_t idx = 0; idx < n; ++idx)
+        BOOST_TEST(
+                ints[idx] == std::clamp<std::int64_t>(
+                                     longs[idx], std::numeric_limits<std::int32_t>::min(),
+                                     std::numeric_limits<std::int32_t>::max()));
+}
+
+BOOST_AUTO_TEST_CASE(memberwise_kernels) {
+    // Members of a compound are gathered so that they use the same kernels as plain arrays
+    struct Wide {
+        double x;
+        std::int64_t y;
+        float z;
+    };
+    struct Narrow {
+        float x;
+        std::int32_t y;
+        double z;
+    };
+    H5::CompType wideType(sizeof(Wide));
+    wideType.insertMember("x", HOFFSET(Wide, x), H5::PredType::NATIVE_DOUBLE);
+    wideType.insertMember("y", HOFFSET(Wide, y), H5::PredType::NATIVE_INT64);
+    wideType.insertMember("z", HOFFSET(Wide, z), H5::PredType::NATIVE_FLOAT);
+    H5::CompType narrowType(sizeof(Narrow));
+    narrowType.insertMember("x", HOFFSET(Narrow, x), H5::PredType::NATIVE_FLOAT);
+    narrowType.insertMember("y", HOFFSET(Narrow, y), H5::PredType::NATIVE_INT32);
+    narrowType.insertMember("z", HOFFSET(Narrow, z), H5::PredType::NATIVE_DOUBLE);
+    std::unique_ptr<MemberwiseConverter> converter =
+            MemberwiseConverter::create(wideType, narrowType);
+    BOOST_REQUIRE(converter);
+    constexpr std::size_t n = 1003;
+    std::vector<Wide> wide(n);
+    for (std::size_t idx = 0; idx < n; ++idx)
+        wide[idx] = Wide{
+                1.1 * idx - 500, (static_cast<std::int64_t>(idx) - 500) * 10000000,
+                0.25f * idx};
+    std::vector<Narrow> narrow(n);
+    (*converter)(wide.data(), narrow.data(), n);
+    for (std::size_t idx = 0; idx < n; ++idx) {
+        BOOST_TEST(narrow[idx].x == static_cast<float>(wide[idx].x));
+        BOOST_TEST(
+                narrow[idx].y == std::clamp<std::int64_t>(
+                                         wide[idx].y, std::numeric_limits<std::int32_t>::min(),
+                                         std::numeric_limits<std::int32_t>::max()));
+        BOOST_TEST(narrow[idx].z == static_cast<double>(wide[idx].z));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(numeric_byte_order_arrays) {
+    constexpr std::size_t n = 1003;
+    std::vector<short> shorts(n);
+    std::vector<double> doubles(n);
+    for (std::size_t idx = 0; idx < n; ++idx) {
+        shorts[idx] = static_cast<short>(idx * 37 - 20000);
+        doubles[idx] = 1.1 * idx - 500;
+    }
+    H5::DataType swappedShort = H5::PredType::NATIVE_SHORT == H5::PredType::STD_I16LE
+                                        ? H5::PredType::STD_I16BE
+                                        : H5::PredType::STD_I16LE;
+    H5::DataType swappedDouble = H5::PredType::NATIVE_DOUBLE == H5::PredType::IEEE_F64LE
+                                         ? H5::PredType::IEEE_F64BE
+                                         : H5::PredType::IEEE_F64LE;
+    std::vector<short> swappedShorts(n);
+    convert(H5BufferConstView(shorts.data(), H5::PredType::NATIVE_SHORT),
+            H5BufferView(swappedShorts.data(), swappedShort), n);
+    std::vector<double> swappedDoubles(n);
+    convert(H5BufferConstView(doubles.data(), H5::PredType::NATIVE_DOUBLE),
+            H5BufferView(swappedDoubles.data(), swappedDouble), n);
+    // Compare against the H5 conversions
+    std::vector<short> expectedShorts(shorts);
+    H5::DataType(H5::PredType::NATIVE_SHORT)
+            .convert(swappedShort, n, expectedShorts.data(), nullptr);
+    BOOST_TEST(expectedShorts == swappedShorts);
+    std::vector<double> expectedDoubles(doubles);
+    H5::DataType(H5::PredType::NATIVE_DOUBLE)
+            .convert(swappedDouble, n, expectedDoubles.data(), nullptr);
+    BOOST_TEST(
+            std::memcmp(expectedDoubles.data(), swappedDoubles.data(), n * sizeof(double)) == 0);
+}
+
+BOOST_AUTO_TEST_CASE(numeric_byte_order) {
+    H5::DataType swappedType = H5::PredType::NATIVE_INT == H5::PredType::STD_I32LE
+                                       ? H5::PredType::STD_I32BE
+                                       : H5::PredType::STD_I32LE;
+    std::unique_ptr<MemberwiseConverter> converter =
+            MemberwiseConverter::create(H5::PredType::NATIVE_INT, swappedType);
+    BOOST_REQUIRE(converter);
+    int values[2]{1, -2};
+    int swapped[2];
+    (*converter)(values, swapped, 2);
+    std::memcpy(values, swapped, sizeof(values));
+    H5::DataType(swappedType).convert(H5::PredType::NATIVE_INT, 2, values, nullptr);
+    BOOST_TEST(values[0] == 1);
+    BOOST_TEST(values[1] == -2);
+    // Changing the type and the byte order is left to H5
+    BOOST_TEST(!MemberwiseConverter::create(H5::PredType::NATIVE_DOUBLE, swappedType));
+}
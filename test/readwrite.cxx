@@ -0,0 +1,767 @@
+#define BOOST_TEST_MODULE readwrite
+
+#include "H5Composites/CompDTypeUtils.hxx"
+#include "H5Composites/ConcurrentWriter.hxx"
+#include "H5Composites/DataSetIndex.hxx"
+#include "H5Composites/DataSetUtils.hxx"
+#include "H5Composites/GroupWrapper.hxx"
+#include "H5Composites/H5Struct.hxx"
+#include "H5Composites/ParallelScan.hxx"
+#include "H5Composites/TypedReader.hxx"
+#include "H5Composites/TypedWriter.hxx"
+#include "H5Composites/traits/String.hxx"
+#include "H5Composites/traits/Vector.hxx"
+#include <boost/test/included/unit_test.hpp>
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+using namespace H5Composites;
+
+struct A {
+    float x;
+    int y;
+
+    H5COMPOSITES_INLINE_STRUCT_DTYPE(A, x, y)
+};
+
+struct B {
+    double x;
+    long long y;
+
+    H5COMPOSITES_INLINE_STRUCT_DTYPE(B, x, y)
+};
+
+BOOST_AUTO_TEST_CASE(direct_write) {
+    H5::H5File file("readwrite_direct.h5", H5F_ACC_TRUNC);
+    {
+        TypedWriter<A> writer(file, "data", 16);
+        BOOST_TEST(writer.isDirectlyWritable(getH5DType<A>()));
+        BOOST_TEST(!writer.isDirectlyWritable(getH5DType<B>()));
+        for (std::size_t idx = 0; idx < 100; ++idx)
+            writer.write(A{0.5f * idx, static_cast<int>(idx)});
+    }
+    TypedReader<A> reader(file.openDataSet("data"));
+    for (std::size_t idx = 0; idx < 100; ++idx) {
+        std::optional<A> a = reader.next();
+        BOOST_REQUIRE(a);
+        BOOST_TEST(a->x == 0.5f * idx);
+        BOOST_TEST(a->y == idx);
+    }
+    BOOST_TEST(!reader.next());
+}
+
+BOOST_AUTO_TEST_CASE(converted_write) {
+    H5::H5File file("readwrite_converted.h5", H5F_ACC_TRUNC);
+    {
+        // Writing A objects into a B dataset has to go through the conversion
+        Writer writer(file, "data", getH5DType<B>(), 16);
+        for (std::size_t idx = 0; idx < 100; ++idx)
+            writer.write(A{0.5f * idx, static_cast<int>(idx)});
+    }
+    TypedReader<B> reader(file.openDataSet("data"));
+    for (std::size_t idx = 0; idx < 100; ++idx) {
+        std::optional<B> b = reader.next();
+        BOOST_REQUIRE(b);
+        BOOST_TEST(b->x == 0.5 * idx);
+        BOOST_TEST(b->y == idx);
+    }
+    BOOST_TEST(!reader.next());
+}
+
+BOOST_AUTO_TEST_CASE(span_write) {
+    H5::H5File file("readwrite_span.h5", H5F_ACC_TRUNC);
+    std::vector<A> as;
+    for (std::size_t idx = 0; idx < 100; ++idx)
+        as.push_back(A{0.5f * idx, static_cast<int>(idx)});
+    {
+        TypedWriter<A> direct(file, "direct", 16);
+        // Small spans go through the cache, large ones bypass it
+        direct.write(std::span(as).first(10));
+        direct.write(as.begin() + 10, as.end());
+        Writer converted(file, "converted", getH5DType<B>(), 16);
+        converted.write(std::span(as).first(10));
+        converted.write(std::span(as).subspan(10));
+        // Memberwise conversions still go through the cache rather than H5
+        BOOST_TEST(converted.metrics().blocks == 100 / 16);
+    }
+    for (const std::string name : {"direct", "converted"}) {
+        TypedReader<B> reader(file.openDataSet(name));
+        for (std::size_t idx = 0; idx < 100; ++idx) {
+            std::optional<B> b = reader.next();
+            BOOST_REQUIRE(b);
+            BOOST_TEST(b->x == 0.5 * idx);
+            BOOST_TEST(b->y == idx);
+        }
+        BOOST_TEST(!reader.next());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(block_read) {
+    H5::H5File file("readwrite_block.h5", H5F_ACC_TRUNC);
+    {
+        TypedWriter<A> writer(file, "data", 16);
+        for (std::size_t idx = 0; idx < 100; ++idx)
+            writer.write(A{0.5f * idx, static_cast<int>(idx)});
+    }
+    Reader reader(file.openDataSet("data"), 16);
+    std::size_t idx = 0;
+    // Each block can only hold what is left in the cache
+    for (std::size_t expected : {10, 6}) {
+        H5BufferConstView block = reader.nextBlock(10);
+        BOOST_TEST(block.size() == expected);
+        for (H5BufferConstView row : block)
+            BOOST_TEST(fromBuffer<A>(row).y == idx++);
+    }
+    // Read the rest straight into memory, converting as we go
+    reader.next();
+    ++idx;
+    std::vector<B> bs(100);
+    BOOST_TEST(reader.readInto(std::span(bs)) == 100 - idx);
+    for (std::size_t jdx = 0; idx < 100; ++idx, ++jdx) {
+        BOOST_TEST(bs[jdx].x == 0.5 * idx);
+        BOOST_TEST(bs[jdx].y == idx);
+    }
+    BOOST_TEST(!reader.nextBlock(10));
+}
+
+BOOST_AUTO_TEST_CASE(block_read_checks_conversion) {
+    H5::H5File file("readwrite_block_check.h5", H5F_ACC_TRUNC);
+    {
+        TypedWriter<A> writer(file, "data", 16);
+        for (std::size_t idx = 0; idx < 20; ++idx)
+            writer.write(A{0.5f * idx, static_cast<int>(idx)});
+    }
+    // The error is the same whether the rows come from the cache or straight from the file
+    std::vector<int> ys(10);
+    Reader direct(file.openDataSet("data"), 16);
+    BOOST_CHECK_THROW(direct.readInto(std::span(ys)), InvalidConversionError);
+    Reader cached(file.openDataSet("data"), 16);
+    cached.next();
+    BOOST_CHECK_THROW(cached.readInto(std::span(ys)), InvalidConversionError);
+}
+
+BOOST_AUTO_TEST_CASE(prefetch) {
+    H5::H5File file("readwrite_prefetch.h5", H5F_ACC_TRUNC);
+    {
+        TypedWriter<A> writer(file, "data", 16);
+        for (std::size_t idx = 0; idx < 1000; ++idx)
+            writer.write(A{0.5f * idx, static_cast<int>(idx)});
+    }
+    Reader reader(file.openDataSet("data"), 16);
+    // Read a little before starting the background thread
+    std::size_t idx = 0;
+    for (; idx < 5; ++idx)
+        BOOST_TEST(fromBuffer<A>(reader.next()).y == idx);
+    reader.startPrefetching(3);
+    BOOST_TEST(reader.isPrefetching());
+    for (; idx < 500; ++idx)
+        BOOST_TEST(fromBuffer<A>(reader.next()).y == idx);
+    std::vector<A> as(1000);
+    BOOST_TEST(reader.readInto(std::span(as)) == 500);
+    for (std::size_t jdx = 0; jdx < 500; ++jdx)
+        BOOST_TEST(as[jdx].y == idx + jdx);
+    BOOST_TEST(!reader.next());
+}
+
+BOOST_AUTO_TEST_CASE(async_flush) {
+    H5::H5File file("readwrite_async.h5", H5F_ACC_TRUNC);
+    std::vector<A> as;
+    for (std::size_t idx = 0; idx < 100; ++idx)
+        as.push_back(A{0.5f * idx, static_cast<int>(idx)});
+    {
+        TypedWriter<A> writer(file, "data", 16);
+        writer.startAsyncFlushing(2);
+        BOOST_TEST(writer.isFlushingAsync());
+        for (std::size_t idx = 0; idx < 1000; ++idx)
+            writer.write(A{0.5f * idx, static_cast<int>(idx)});
+        // Large writes bypass the cache and must wait for the queue to drain
+        writer.write(std::span(as));
+        writer.write(A{0.5f, 1});
+        writer.flush();
+        writer.sync();
+        BOOST_TEST(writer.offset() == 1101);
+    }
+    Reader reader(file.openDataSet("data"));
+    BOOST_TEST(reader.nRemaining() == 1101);
+    std::vector<A> readBack(1101);
+    BOOST_TEST(reader.readInto(std::span(readBack)) == 1101);
+    for (std::size_t idx = 0; idx < 1000; ++idx)
+        BOOST_TEST(readBack[idx].y == idx);
+    for (std::size_t idx = 0; idx < 100; ++idx)
+        BOOST_TEST(readBack[1000 + idx].y == idx);
+    BOOST_TEST(readBack[1100].y == 1);
+}
+
+BOOST_AUTO_TEST_CASE(filters) {
+    H5::H5File file("readwrite_filters.h5", H5F_ACC_TRUNC);
+    DataSetCreationOptions options;
+    options.deflateLevel = 6;
+    options.shuffle = true;
+    options.fletcher32 = true;
+    // Not registered here so should be skipped
+    options.filters.push_back({.id = DataSetCreationOptions::lzfFilterID});
+    {
+        TypedWriter<A> writer(file, "data", 16, -1, options);
+        for (std::size_t idx = 0; idx < 100; ++idx)
+            writer.write(A{0.5f * idx, static_cast<int>(idx)});
+    }
+    H5::DataSet dataset = file.openDataSet("data");
+    H5::DSetCreatPropList propList = dataset.getCreatePlist();
+    BOOST_TEST(propList.getNfilters() == 3);
+    TypedReader<A> reader(dataset);
+    for (std::size_t idx = 0; idx < 100; ++idx)
+        BOOST_TEST(reader.next()->y == idx);
+
+    options.filters.back().optional = false;
+    BOOST_CHECK_THROW(TypedWriter<A>(file, "fail", 16, -1, options), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(auto_chunk) {
+    H5::H5File file("readwrite_autochunk.h5", H5F_ACC_TRUNC);
+    DataSetCreationOptions options;
+    options.targetChunkBytes = 1024;
+    {
+        TypedWriter<A> writer(file, "data", 16, -1, options);
+        writer.write(A{0.5f, 1});
+    }
+    hsize_t chunkSize;
+    file.openDataSet("data").getCreatePlist().getChunk(1, &chunkSize);
+    BOOST_TEST(chunkSize == 1024 / sizeof(A));
+    options.expectedRows = 10;
+    BOOST_TEST(options.chunkRows(sizeof(A)) == 10);
+}
+
+BOOST_AUTO_TEST_CASE(threaded_merge) {
+    H5::H5File file("readwrite_merge.h5", H5F_ACC_TRUNC);
+    std::vector<H5::DataSet> inputs;
+    for (std::size_t iFile = 0; iFile < 3; ++iFile) {
+        std::string name = "input" + std::to_string(iFile);
+        {
+            // Mix the types so that the merge has to convert some of the inputs
+            Writer writer(file, name, iFile == 1 ? getH5DType<B>() : getH5DType<A>(), 16);
+            for (std::size_t idx = 0; idx < 50 + iFile; ++idx)
+                writer.write(A{0.5f * idx, static_cast<int>(100 * iFile + idx)});
+        }
+        inputs.push_back(file.openDataSet(name));
+    }
+    mergeDataSets(file, "serial", inputs, 10 * sizeof(B));
+    mergeDataSets(file, "threaded", inputs, 10 * sizeof(B), 0, {}, 2);
+    BOOST_TEST(file.openDataSet("threaded").getSpace().getSimpleExtentNpoints() == 153);
+    TypedReader<B> serial(file.openDataSet("serial"));
+    TypedReader<B> threaded(file.openDataSet("threaded"));
+    for (std::size_t iFile = 0; iFile < 3; ++iFile)
+        for (std::size_t idx = 0; idx < 50 + iFile; ++idx) {
+            BOOST_TEST(serial.next()->y == 100 * iFile + idx);
+            BOOST_TEST(threaded.next()->y == 100 * iFile + idx);
+        }
+}
+
+BOOST_AUTO_TEST_CASE(raw_chunk_merge) {
+    H5::H5File file("readwrite_rawmerge.h5", H5F_ACC_TRUNC);
+    DataSetCreationOptions options;
+    options.deflateLevel = 4;
+    std::vector<H5::DataSet> inputs;
+    // The first input is chunk aligned, the second ends in a partial chunk so the third is copied
+    // element-wise
+    std::vector<std::size_t> nRows{32, 40, 20};
+    for (std::size_t iFile = 0; iFile < nRows.size(); ++iFile) {
+        std::string name = "input" + std::to_string(iFile);
+        {
+            TypedWriter<A> writer(file, name, 16, -1, options);
+            for (std::size_t idx = 0; idx < nRows[iFile]; ++idx)
+                writer.write(A{0.5f * idx, static_cast<int>(100 * iFile + idx)});
+        }
+        inputs.push_back(file.openDataSet(name));
+    }
+    mergeDataSets(file, "merged", inputs, 16 * sizeof(A), 0, options);
+    TypedReader<A> reader(file.openDataSet("merged"));
+    for (std::size_t iFile = 0; iFile < nRows.size(); ++iFile)
+        for (std::size_t idx = 0; idx < nRows[iFile]; ++idx) {
+            std::optional<A> a = reader.next();
+            BOOST_REQUIRE(a);
+            BOOST_TEST(a->x == 0.5f * idx);
+            BOOST_TEST(a->y == 100 * iFile + idx);
+        }
+    BOOST_TEST(!reader.next());
+}
+
+struct C {
+    A a;
+    double z;
+    B b;
+
+    H5COMPOSITES_INLINE_STRUCT_DTYPE(C, a, z, b)
+};
+
+BOOST_AUTO_TEST_CASE(projection) {
+    H5::H5File file("readwrite_projection.h5", H5F_ACC_TRUNC);
+    {
+        TypedWriter<C> writer(file, "data", 16);
+        for (std::size_t idx = 0; idx < 20; ++idx)
+            writer.write(C{A{0.5f * idx, static_cast<int>(idx)}, 2.0 * idx, B{}});
+    }
+    Reader reader(file.openDataSet("data"), {"z", "a.y"});
+    H5::CompType dtype(reader.dtype().getId());
+    BOOST_TEST(getCompoundElementNames(dtype) == std::vector<std::string>({"a", "z"}));
+    BOOST_TEST(dtype.getSize() == sizeof(int) + sizeof(double));
+    H5::CompType aDType = dtype.getMemberCompType(0);
+    BOOST_TEST(getCompoundElementNames(aDType) == std::vector<std::string>({"y"}));
+    for (std::size_t idx = 0; idx < 20; ++idx) {
+        H5BufferConstView view = reader.next();
+        BOOST_REQUIRE(view);
+        int y;
+        double z;
+        std::memcpy(&y, getMemberPointer(view.get(), dtype, "a"), sizeof(int));
+        std::memcpy(&z, getMemberPointer(view.get(), dtype, "z"), sizeof(double));
+        BOOST_TEST(y == idx);
+        BOOST_TEST(z == 2.0 * idx);
+    }
+    BOOST_CHECK_THROW(Reader(file.openDataSet("data"), {"a.w"}), std::invalid_argument);
+    BOOST_CHECK_THROW(Reader(file.openDataSet("data"), {"z.w"}), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(projection_skips_vlen) {
+    H5::H5File file("readwrite_projection_vlen.h5", H5F_ACC_TRUNC);
+    struct Named {
+        float x;
+        const char *name;
+        int y;
+    };
+    H5::CompType fileDType(sizeof(Named));
+    fileDType.insertMember("x", offsetof(Named, x), H5::PredType::NATIVE_FLOAT);
+    fileDType.insertMember("name", offsetof(Named, name), H5::StrType(0, H5T_VARIABLE));
+    fileDType.insertMember("y", offsetof(Named, y), H5::PredType::NATIVE_INT);
+    std::vector<Named> rows;
+    for (std::size_t idx = 0; idx < 100; ++idx)
+        rows.push_back(Named{0.5f * idx, "a name long enough to be worth leaking", int(idx)});
+    hsize_t nRows = rows.size();
+    H5::DataSet dataset = file.createDataSet("data", fileDType, H5::DataSpace(1, &nRows));
+    dataset.write(rows.data(), fileDType);
+
+    // The conversion only needs the numeric members, so the strings are never read
+    std::shared_ptr<const ConversionPlan> plan =
+            ConversionPlanCache::instance().get(dataset.getDataType(), getH5DType<B>());
+    BOOST_TEST(plan->readDType.getSize() == sizeof(float) + sizeof(int));
+    BOOST_TEST(plan->readMemberwise);
+    TypedReader<B> converted(dataset, 16);
+    for (std::size_t idx = 0; idx < 100; ++idx) {
+        std::optional<B> b = converted.next();
+        BOOST_REQUIRE(b);
+        BOOST_TEST(b->x == 0.5 * idx);
+        BOOST_TEST(b->y == idx);
+    }
+    BOOST_TEST(!converted.next());
+
+    Reader projected(dataset, {"y"});
+    BOOST_TEST(projected.dtype().getSize() == sizeof(int));
+    for (std::size_t idx = 0; idx < 100; ++idx) {
+        H5BufferConstView view = projected.next();
+        BOOST_REQUIRE(view);
+        int y;
+        std::memcpy(&y, view.get(), sizeof(int));
+        BOOST_TEST(y == idx);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(vlen_arena) {
+    H5::H5File file("readwrite_arena.h5", H5F_ACC_TRUNC);
+    {
+        TypedWriter<std::string> strings(file, "strings", 16);
+        strings.useVLenArena(256);
+        TypedWriter<std::vector<int>> vectors(file, "vectors", 16);
+        vectors.useVLenArena();
+        vectors.startAsyncFlushing();
+        BOOST_CHECK_THROW(vectors.useVLenArena(), std::logic_error);
+        for (std::size_t idx = 0; idx < 100; ++idx) {
+            strings.write(std::string(idx % 40, 'a' + idx % 26));
+            vectors.write(std::vector<int>(idx % 7, idx));
+        }
+    }
+    TypedReader<std::string> strings(file.openDataSet("strings"));
+    strings.useVLenArena();
+    Reader vectors(getH5DType<std::vector<int>>(), file.openDataSet("vectors"));
+    vectors.useVLenArena();
+    vectors.startPrefetching();
+    for (std::size_t idx = 0; idx < 100; ++idx) {
+        BOOST_TEST(*strings.next() == std::string(idx % 40, 'a' + idx % 26));
+        BOOST_TEST(*vectors.next<std::vector<int>>() == std::vector<int>(idx % 7, idx));
+    }
+    BOOST_TEST(!strings.next());
+    BOOST_TEST(!vectors.next());
+}
+
+BOOST_AUTO_TEST_CASE(vlen_span_write) {
+    H5::H5File file("readwrite_vlen_span.h5", H5F_ACC_TRUNC);
+    H5::DataType dtype = getH5DType<std::vector<int>>();
+    // Rows owned by the caller, which the writers must copy rather than take over
+    auto makeRows = [] {
+        std::vector<hvl_t> rows(3);
+        for (std::size_t idx = 0; idx < rows.size(); ++idx) {
+            rows[idx].len = idx + 1;
+            rows[idx].p = std::malloc(rows[idx].len * sizeof(int));
+            for (std::size_t jdx = 0; jdx < rows[idx].len; ++jdx)
+                static_cast<int *>(rows[idx].p)[jdx] = idx;
+        }
+        return rows;
+    };
+    auto freeRows = [](std::vector<hvl_t> &rows) {
+        for (hvl_t &row : rows) {
+            // Anything still shared with the writer would be seen in the file
+            std::memset(row.p, 0xff, row.len * sizeof(int));
+            std::free(row.p);
+        }
+    };
+    {
+        Writer writer(file, "writer", dtype, 16);
+        std::vector<hvl_t> rows = makeRows();
+        writer.writeFromBuffer(H5BufferConstView(rows.data(), dtype), rows.size());
+        writer.flush();
+        freeRows(rows);
+    }
+    {
+        ConcurrentWriter writer(file, "concurrent", dtype, 16);
+        std::vector<hvl_t> rows = makeRows();
+        {
+            ConcurrentWriter::Producer producer = writer.makeProducer();
+            producer.writeFromBuffer(H5BufferConstView(rows.data(), dtype), rows.size());
+            producer.flush();
+        }
+        writer.sync();
+        freeRows(rows);
+    }
+    for (const char *name : {"writer", "concurrent"}) {
+        TypedReader<std::vector<int>> reader(file.openDataSet(name));
+        for (std::size_t idx = 0; idx < 3; ++idx)
+            BOOST_TEST(*reader.next() == std::vector<int>(idx + 1, idx));
+        BOOST_TEST(!reader.next());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(columnar) {
+    GroupWrapper file(
+            H5::H5File("readwrite_columnar.h5", H5F_ACC_TRUNC).openGroup("/"),
+            TypeRegister::instance().enumType());
+    {
+        ColumnarWriter writer = file.makeColumnarWriter<C>("data", 16);
+        BOOST_TEST(
+                writer.columnNames() ==
+                std::vector<std::string>({"a.x", "a.y", "z", "b.x", "b.y"}));
+        std::vector<C> values;
+        for (std::size_t idx = 0; idx < 30; ++idx)
+            values.push_back(C{A{0.5f * idx, static_cast<int>(idx)}, 2.0 * idx, B{-1.0 * idx, 7}});
+        writer.write(std::span(values));
+        // Converted from a different type
+        H5::CompType partial(sizeof(float));
+        partial.insertMember("z", 0, H5::PredType::NATIVE_FLOAT);
+        float z = 100.f;
+        writer.writeFromBuffer(H5BufferConstView(&z, partial));
+        BOOST_TEST(writer.nRows() == 31);
+    }
+    ColumnarReader reader = file.makeColumnarReader("data", 8);
+    for (std::size_t idx = 0; idx < 30; ++idx) {
+        std::optional<C> c = reader.next<C>();
+        BOOST_REQUIRE(c);
+        BOOST_TEST(c->a.x == 0.5f * idx);
+        BOOST_TEST(c->a.y == idx);
+        BOOST_TEST(c->z == 2.0 * idx);
+        BOOST_TEST(c->b.x == -1.0 * idx);
+        BOOST_TEST(c->b.y == 7);
+    }
+    std::optional<C> last = reader.next<C>();
+    BOOST_REQUIRE(last);
+    BOOST_TEST(last->a.y == 0);
+    BOOST_TEST(last->z == 100);
+    BOOST_TEST(!reader.next());
+
+    ColumnarReader projected = file.makeColumnarReader("data", {"z", "a.y"});
+    BOOST_TEST(projected.columnNames() == std::vector<std::string>({"a.y", "z"}));
+    H5BufferConstView block = projected.nextBlock(40);
+    BOOST_TEST(getNArrayElements(H5::ArrayType(block.dtype().getId())) == 16);
+
+    Reader column = reader.columnReader("z");
+    for (std::size_t idx = 0; idx < 30; ++idx)
+        BOOST_TEST(*column.next<double>() == 2.0 * idx);
+}
+
+BOOST_AUTO_TEST_CASE(concurrent_write) {
+    H5::H5File file("readwrite_concurrent.h5", H5F_ACC_TRUNC);
+    constexpr std::size_t nThreads = 4;
+    constexpr std::size_t nBatches = 25;
+    constexpr std::size_t batchSize = 37;
+    {
+        ConcurrentWriter writer(file, "arrival", A::h5DType(), 16);
+        std::vector<std::thread> threads;
+        for (std::size_t thread = 0; thread < nThreads; ++thread)
+            threads.emplace_back([&writer, thread] {
+                ConcurrentWriter::Producer producer = writer.makeProducer();
+                for (std::size_t idx = 0; idx < nBatches * batchSize; ++idx)
+                    producer.write(A{0.5f * idx, static_cast<int>(thread)});
+            });
+        for (std::thread &thread : threads)
+            thread.join();
+        writer.sync();
+        BOOST_TEST(writer.nWritten() == nThreads * nBatches * batchSize);
+    }
+    {
+        ConcurrentWriter writer(
+                file, "ordered", A::h5DType(), 16, -1, {}, ConcurrentWriter::CommitOrder::Sequence);
+        std::vector<std::thread> threads;
+        for (std::size_t thread = 0; thread < nThreads; ++thread)
+            threads.emplace_back([&writer, thread] {
+                ConcurrentWriter::Producer producer = writer.makeProducer();
+                // Each thread handles every nThreads'th batch
+                for (std::size_t batch = thread; batch < nBatches; batch += nThreads) {
+                    for (std::size_t idx = 0; idx < batchSize; ++idx)
+                        producer.write(A{0.5f * idx, static_cast<int>(batch * batchSize + idx)});
+                    producer.commit(batch);
+                }
+            });
+        for (std::thread &thread : threads)
+            thread.join();
+        ConcurrentWriter::Producer producer = writer.makeProducer();
+        BOOST_CHECK_THROW(producer.flush(), std::logic_error);
+        BOOST_CHECK_THROW(producer.commit(0), std::invalid_argument);
+    }
+    Reader arrival(file.openDataSet("arrival"));
+    std::vector<std::size_t> counts(nThreads);
+    while (std::optional<A> a = arrival.next<A>())
+        ++counts.at(a->y);
+    for (std::size_t count : counts)
+        BOOST_TEST(count == nBatches * batchSize);
+    Reader ordered(file.openDataSet("ordered"));
+    BOOST_TEST(ordered.nRemaining() == nBatches * batchSize);
+    for (std::size_t idx = 0; idx < nBatches * batchSize; ++idx)
+        BOOST_TEST(ordered.next<A>()->y == idx);
+}
+
+BOOST_AUTO_TEST_CASE(metrics) {
+    H5::H5File file("readwrite_metrics.h5", H5F_ACC_TRUNC);
+    MetricsRegistry &registry = MetricsRegistry::instance();
+    IOMetrics writersBefore = registry.totals(IOMetricsRecorder::Source::Writer);
+    std::size_t nCallbacks = 0;
+    {
+        Writer writer(file, "data", getH5DType<A>(), 16);
+        writer.setMetricsCallback([&nCallbacks](const IOMetrics &) { ++nCallbacks; });
+        // Writing a different type forces a conversion
+        for (std::size_t idx = 0; idx < 100; ++idx)
+            writer.write(B{0.5 * idx, static_cast<long long>(idx)});
+        IOMetrics metrics = writer.metrics();
+        BOOST_TEST(metrics.rows == 96);
+        BOOST_TEST(metrics.bytes == 96 * sizeof(A));
+        BOOST_TEST(metrics.blocks == 6);
+        BOOST_TEST(metrics.conversionTime.count() > 0);
+        BOOST_TEST(metrics.ioTime.count() > 0);
+        BOOST_TEST(nCallbacks == 6);
+    }
+    BOOST_TEST(nCallbacks == 7);
+    IOMetrics writersAfter = registry.totals(IOMetricsRecorder::Source::Writer);
+    BOOST_TEST(writersAfter.rows - writersBefore.rows == 100);
+    BOOST_TEST(writersAfter.blocks - writersBefore.blocks == 7);
+
+    TypedReader<A> reader(file.openDataSet("data"), 16);
+    while (reader.next())
+        ;
+    IOMetrics metrics = reader.metrics();
+    BOOST_TEST(metrics.rows == 100);
+    BOOST_TEST(metrics.blocks == 7);
+    BOOST_TEST(registry.nLive(IOMetricsRecorder::Source::Reader) >= 1);
+    reader.resetMetrics();
+    BOOST_TEST(reader.metrics().rows == 0);
+}
+
+BOOST_AUTO_TEST_CASE(random_access) {
+    H5::H5File file("readwrite_random_access.h5", H5F_ACC_TRUNC);
+    {
+        TypedWriter<A> writer(file, "data", 32, 10);
+        for (std::size_t idx = 0; idx < 1000; ++idx)
+            writer.write(A{0.5f * idx, static_cast<int>(idx)});
+    }
+    TypedReader<A> reader(file.openDataSet("data"), 32);
+    BOOST_TEST(reader.size() == 1000);
+    reader.setBlockCacheSize(2);
+    BOOST_TEST(reader.read(517).y == 517);
+    BOOST_TEST(reader.read(0).y == 0);
+    BOOST_TEST(reader.read(999).y == 999);
+    BOOST_TEST(reader.read(518).y == 518);
+    std::size_t nBlocks = reader.metrics().blocks;
+    BOOST_TEST(reader.read(515).y == 515);
+    BOOST_TEST(reader.metrics().blocks == nBlocks);
+    std::vector<A> range = reader.readRange(25, 100);
+    BOOST_TEST(range.size() == 100);
+    for (std::size_t idx = 0; idx < range.size(); ++idx)
+        BOOST_TEST(range[idx].y == 25 + idx);
+    BOOST_TEST(reader.readRange(990, 100).size() == 10);
+    BOOST_CHECK_THROW(reader.read(1000), std::out_of_range);
+
+    // Random access leaves the forward position alone
+    BOOST_TEST(reader.position() == 0);
+    BOOST_TEST(reader.next()->y == 0);
+    reader.seek(700);
+    BOOST_TEST(reader.position() == 700);
+    BOOST_TEST(reader.next()->y == 700);
+    // Seeking back within the cache does not read anything
+    nBlocks = reader.metrics().blocks;
+    reader.seek(710);
+    BOOST_TEST(reader.next()->y == 710);
+    reader.seek(701);
+    BOOST_TEST(reader.next()->y == 701);
+    BOOST_TEST(reader.metrics().blocks == nBlocks);
+    reader.seek(1000);
+    BOOST_TEST(!reader.next());
+}
+
+BOOST_AUTO_TEST_CASE(memory_map) {
+    H5::H5File file("readwrite_memory_map.h5", H5F_ACC_TRUNC);
+    std::vector<A> data;
+    for (std::size_t idx = 0; idx < 1000; ++idx)
+        data.push_back(A{0.5f * idx, static_cast<int>(idx)});
+    {
+        // Only contiguous datasets can be mapped, the writer always makes chunked ones
+        hsize_t nRows = data.size();
+        H5::DataSet dataset =
+                file.createDataSet("contiguous", getH5DType<A>(), H5::DataSpace(1, &nRows));
+        dataset.write(data.data(), getH5DType<A>());
+        TypedWriter<A> writer(file, "chunked", 32);
+        writer.write(data.begin(), data.end());
+    }
+    TypedReader<A> reader(file.openDataSet("contiguous"), 64);
+    BOOST_TEST(reader.next()->y == 0);
+    BOOST_TEST(reader.useMemoryMap());
+    BOOST_TEST(reader.isMemoryMapped());
+    // Reading carries on from the same row
+    for (std::size_t idx = 1; idx < 200; ++idx) {
+        std::optional<A> a = reader.next();
+        BOOST_REQUIRE(a);
+        BOOST_TEST(a->x == 0.5f * idx);
+        BOOST_TEST(a->y == idx);
+    }
+    BOOST_TEST(reader.read(917).y == 917);
+    std::vector<A> range = reader.readRange(990, 100);
+    BOOST_TEST(range.size() == 10);
+    BOOST_TEST(range.front().y == 990);
+    reader.seek(998);
+    BOOST_TEST(reader.next()->y == 998);
+    BOOST_TEST(reader.next()->y == 999);
+    BOOST_TEST(!reader.next());
+
+    TypedReader<A> chunked(file.openDataSet("chunked"));
+    BOOST_TEST(!chunked.useMemoryMap());
+    TypedReader<B> converted(file.openDataSet("contiguous"));
+    BOOST_TEST(!converted.useMemoryMap());
+    BOOST_TEST(!converted.isMemoryMapped());
+    BOOST_TEST(converted.next()->y == 0);
+}
+
+BOOST_AUTO_TEST_CASE(parallel_scan) {
+    H5::H5File file("readwrite_parallel_scan.h5", H5F_ACC_TRUNC);
+    {
+        TypedWriter<A> writer(file, "data", 100, 100);
+        for (std::size_t idx = 0; idx < 10000; ++idx)
+            writer.write(A{0.5f * idx, static_cast<int>(idx)});
+    }
+    ParallelScan scan(getH5DType<A>(), file.openDataSet("data"), 4, 250);
+    // Blocks are made of whole chunks
+    BOOST_TEST(scan.blockSize() == 300);
+    std::vector<char> seen(scan.nRows(), 0);
+    std::atomic<long long> total{0};
+    std::atomic<std::size_t> nWrong{0};
+    // The test framework is not thread-safe so only count failures in the workers
+    scan.forEach<A>([&](std::size_t worker, std::size_t row, const A &a) {
+        if (worker >= 4 || static_cast<std::size_t>(a.y) != row)
+            ++nWrong;
+        ++seen[row];
+        total += a.y;
+    });
+    BOOST_TEST(nWrong == 0);
+    BOOST_TEST(std::count(seen.begin(), seen.end(), 1) == 10000);
+    BOOST_TEST(total == 9999LL * 10000 / 2);
+    BOOST_TEST(scan.metrics().rows == 10000);
+
+    // Reading as B converts in the workers
+    for (std::size_t nWorkers : {0, 3}) {
+        ParallelScan converted(getH5DType<B>(), file.openDataSet("data"), nWorkers);
+        long long sum = converted.reduce(
+                0LL,
+                [](long long &state, std::size_t, const H5BufferConstView &rows, std::size_t n) {
+                    const B *b = static_cast<const B *>(rows.get());
+                    for (std::size_t idx = 0; idx < n; ++idx)
+                        state += b[idx].y;
+                },
+                [](long long lhs, long long rhs) { return lhs + rhs; });
+        BOOST_TEST(sum == 9999LL * 10000 / 2);
+    }
+
+    // Errors in a callback stop the scan and reach the caller
+    BOOST_CHECK_THROW(
+            scan.forEach([](std::size_t, std::size_t row, const H5BufferConstView &) {
+                if (row == 5000)
+                    throw std::runtime_error("stop");
+            }),
+            std::runtime_error);
+}
+
+struct EventID {
+    unsigned int run;
+    unsigned long long event;
+    float weight;
+
+    H5COMPOSITES_INLINE_STRUCT_DTYPE(EventID, run, event, weight)
+};
+
+BOOST_AUTO_TEST_CASE(secondary_index) {
+    H5::H5File file("readwrite_secondary_index.h5", H5F_ACC_TRUNC);
+    {
+        TypedWriter<EventID> writer(file, "data", 64);
+        // Events are written out of order with each (run, event) pair appearing twice
+        for (std::size_t idx = 0; idx < 1000; ++idx)
+            writer.write(EventID{
+                    static_cast<unsigned int>(idx % 2),
+                    static_cast<unsigned long long>((idx * 7919) % 500),
+                    static_cast<float>(idx)});
+        writer.setIndex(std::vector<std::string>{"run", "event"});
+        writer.buildIndex();
+    }
+    H5::DataSet dataset = file.openDataSet("data");
+    BOOST_TEST(DataSetIndex::exists(dataset));
+    TypedReader<EventID> reader(dataset);
+    std::vector<std::size_t> rows = reader.equalRange(1u, 7919ull % 500);
+    BOOST_TEST(rows.size() == 2);
+    for (std::size_t row : rows) {
+        EventID id = reader.read(row);
+        BOOST_TEST(id.run == 1);
+        BOOST_TEST(id.event == 7919 % 500);
+    }
+    BOOST_TEST(std::is_sorted(rows.begin(), rows.end()));
+    // Key values are converted to the stored type
+    BOOST_TEST(reader.find(0, 0).value() == 0);
+    BOOST_TEST(!reader.find(1, 0));
+
+    // Fixed length string keys
+    struct Named {
+        char name[8];
+        int value;
+    };
+    H5::CompType namedDType(sizeof(Named));
+    namedDType.insertMember("name", HOFFSET(Named, name), H5::StrType(H5::PredType::C_S1, 8));
+    namedDType.insertMember("value", HOFFSET(Named, value), H5::PredType::NATIVE_INT);
+    {
+        Writer writer(file, "named", namedDType, 16);
+        int value = 0;
+        for (const char *name : {"delta", "alpha", "charlie", "alpha", "bravo"}) {
+            Named named{};
+            std::strncpy(named.name, name, sizeof(named.name) - 1);
+            named.value = value++;
+            writer.writeFromBuffer(H5BufferConstView(&named, namedDType));
+        }
+    }
+    DataSetIndex::build(file.openDataSet("named"), {"name"});
+    Reader named(file.openDataSet("named"));
+    BOOST_TEST(named.equalRange(std::string("alpha")) == std::vector<std::size_t>({1, 3}));
+    BOOST_TEST(named.find(std::string("bravo")).value() == 4);
+    BOOST_TEST(!named.find(std::string("echo")));
+    BOOST_CHECK_THROW(named.find(1), std::invalid_argument);
+    BOOST_CHECK_THROW(DataSetIndex::build(file.openDataSet("named"), {"missing"}), std::exception);
+}